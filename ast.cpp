@@ -59,6 +59,15 @@ std::string ASTTreePrint::node_tag_to_string(int tag) const {
     return "PARAMETER_LIST";
   case AST_ARGLIST:
     return "ARGLIST";
+  case AST_LAZY_STATEMENT_LIST:
+    return "LAZY_STATEMENT_LIST";
+#define QUICKENED_TAG_NAMES(op) \
+  case AST_##op##_INT_INT:   return #op "_INT_INT"; \
+  case AST_##op##_VAR_CONST: return #op "_VAR_CONST"; \
+  case AST_##op##_VAR_VAR:   return #op "_VAR_VAR"; \
+  case AST_##op##_GENERIC:   return #op "_GENERIC";
+  AST_BINARY_OPERATORS(QUICKENED_TAG_NAMES)
+#undef QUICKENED_TAG_NAMES
   default:
     RuntimeError::raise("Unknown AST node type %d\n", tag);
   }
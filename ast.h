@@ -3,6 +3,12 @@
 
 #include "treeprint.h"
 
+// The binary operators on ints, for use as an "X macro": X(op) is
+// invoked for each operator, whose tag is AST_<op>
+#define AST_BINARY_OPERATORS(X) \
+  X(ADD) X(SUB) X(MULTIPLY) X(DIVIDE) \
+  X(LESS) X(LESS_EQUAL) X(GREATER) X(GREATER_EQUAL) X(EQUAL) X(NOT_EQUAL)
+
 // AST node tags
 enum ASTKind {
   AST_ADD = 2000,
@@ -30,6 +36,27 @@ enum ASTKind {
   AST_STATEMENT_LIST,
   AST_PARAMETER_LIST,
   AST_ARGLIST,
+  AST_LAZY_STATEMENT_LIST, // function body not parsed yet (see Parser2::parse_lazy_body())
+
+  // Quickened binary operators: when an operator node is evaluated,
+  // Interpreter::evaluate() rewrites its tag to one of these variants
+  // of it.  Each operator has the four variants, in this order:
+  //   AST_<op>_INT_INT    int operands
+  //   AST_<op>_VAR_CONST  int operands: a variable and a literal
+  //   AST_<op>_VAR_VAR    int operands: two variables
+  //   AST_<op>_GENERIC    de-specialized, when an operand wasn't an int
+#define AST_QUICKENED_TAGS(op) AST_##op##_INT_INT, AST_##op##_VAR_CONST, AST_##op##_VAR_VAR, AST_##op##_GENERIC,
+  AST_BINARY_OPERATORS(AST_QUICKENED_TAGS)
+#undef AST_QUICKENED_TAGS
+};
+
+// The variants of a quickened binary operator, as offsets
+// from its AST_<op>_INT_INT tag
+enum QuickenedVariant {
+  QUICK_INT_INT,
+  QUICK_VAR_CONST,
+  QUICK_VAR_VAR,
+  QUICK_GENERIC,
 };
 
 class ASTTreePrint : public TreePrint {
@@ -0,0 +1,50 @@
+#include <cstdlib>
+#include "exceptions.h"
+#include "ast_arena.h"
+
+namespace {
+
+// Chunks start out this big, and double in size up to MAX_CHUNK_SIZE,
+// so that small programs don't need much memory and large programs
+// don't need many chunks
+const size_t MIN_CHUNK_SIZE = 64 * 1024;
+const size_t MAX_CHUNK_SIZE = 4 * 1024 * 1024;
+
+}
+
+ASTArena::ASTArena()
+  : m_pos(nullptr)
+  , m_end(nullptr)
+  , m_chunk_size(MIN_CHUNK_SIZE)
+  , m_total_size(0) {
+}
+
+ASTArena::~ASTArena() {
+  for (auto i = m_chunks.begin(); i != m_chunks.end(); ++i) {
+    free(*i);
+  }
+}
+
+// Start a new chunk with room for the requested allocation.  A large
+// allocation (such as the array of children of a long statement list)
+// gets a chunk of its own, so the rest of the current chunk isn't wasted.
+void *ASTArena::allocate_slow(size_t size, size_t align) {
+  bool dedicated = size > MIN_CHUNK_SIZE / 4;
+  size_t chunk_size = dedicated ? size + align : m_chunk_size;
+  char *chunk = static_cast<char *>(malloc(chunk_size));
+  if (chunk == nullptr) {
+    RuntimeError::raise("Out of memory allocating AST");
+  }
+  m_chunks.push_back(chunk);
+  m_total_size += chunk_size;
+
+  char *p = align_up(chunk, align);
+  if (!dedicated) {
+    m_pos = p + size;
+    m_end = chunk + chunk_size;
+    if (m_chunk_size < MAX_CHUNK_SIZE) {
+      m_chunk_size *= 2;
+    }
+  }
+  return p;
+}
@@ -0,0 +1,77 @@
+#ifndef AST_ARENA_H
+#define AST_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "node.h"
+
+// An ASTArena owns the Nodes of one parse, along with their arrays of
+// children.  Memory is handed out from large chunks by bumping a
+// pointer, and nothing is freed until the arena is destroyed, at which
+// point all of the chunks are freed at once.  So, destroying an AST
+// takes time proportional to the number of chunks rather than the
+// number of nodes, and (unlike deleting the nodes one at a time)
+// doesn't recurse to the depth of the tree.
+//
+// Nodes are never destroyed individually, so Node (and NodeBase)
+// must not have members with nontrivial destructors.
+class ASTArena {
+private:
+  char *m_pos, *m_end;          // free space in the current chunk
+  std::vector<char *> m_chunks;
+  size_t m_chunk_size;          // size of the next chunk allocated
+  size_t m_total_size;          // total size of all chunks
+
+  static_assert(std::is_trivially_destructible<Node>::value,
+                "Nodes are freed without being destroyed");
+
+  // value semantics prohibited
+  ASTArena(const ASTArena &);
+  ASTArena &operator=(const ASTArena &);
+
+public:
+  ASTArena();
+  ~ASTArena();
+
+  // Create Nodes in the arena: the arguments are the same as
+  // for the corresponding Node constructors.
+  Node *new_node(int tag) {
+    return ::new (allocate(sizeof(Node), alignof(Node))) Node(*this, tag);
+  }
+  Node *new_node(int tag, std::initializer_list<Node *> kids) {
+    return ::new (allocate(sizeof(Node), alignof(Node))) Node(*this, tag, kids);
+  }
+  Node *new_node(int tag, const std::vector<Node *> &kids) {
+    return ::new (allocate(sizeof(Node), alignof(Node))) Node(*this, tag, kids);
+  }
+  Node *new_node(int tag, std::string_view str) {
+    return ::new (allocate(sizeof(Node), alignof(Node))) Node(*this, tag, str);
+  }
+
+  // Allocate uninitialized memory which lives as long as the arena.
+  void *allocate(size_t size, size_t align) {
+    char *p = align_up(m_pos, align);
+    if (p > m_end || size > size_t(m_end - p)) {
+      return allocate_slow(size, align);
+    }
+    m_pos = p + size;
+    return p;
+  }
+
+  // Get the total size of the memory allocated by the arena.
+  size_t get_total_size() const { return m_total_size; }
+
+private:
+  static char *align_up(char *p, size_t align) {
+    return reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(p) + (align - 1)) & ~uintptr_t(align - 1));
+  }
+
+  void *allocate_slow(size_t size, size_t align);
+};
+
+#endif // AST_ARENA_H
@@ -0,0 +1,451 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+#include "ast.h"
+#include "node.h"
+#include "ast_arena.h"
+#include "exceptions.h"
+#include "source_buffer.h"
+#include "parser2.h"
+#include "stats.h"
+#include "ast_cache.h"
+
+namespace {
+
+const uint32_t CACHE_MAGIC = 0x43414c4d; // "MLAC" when little-endian
+const uint32_t CACHE_VERSION = 1;
+
+const uint32_t NONE = ~0u; // no location or symbol
+
+// flags in CacheHeader
+const uint32_t CACHE_LAZY_BODIES = 1;
+
+struct CacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_hash;
+  uint64_t data_hash;    // hash of the rest of the file, to detect corruption
+  uint32_t source_size;
+  uint32_t flags;
+  uint32_t num_symbols;
+  uint32_t num_nodes;
+};
+
+// A Symbol, as the range of the source text containing its name
+struct SymbolRecord {
+  uint32_t offset;
+  uint32_t len;
+};
+
+// One Node, in a preorder traversal of the AST.  In the file, each
+// node is a tag byte and a flags byte, followed by the fields present
+// according to the flags as LEB128 varints:
+//
+//   num_kids
+//   loc_offset   (if NODE_HAS_LOC) as the zigzag-encoded difference
+//                from the previous node's location
+//   str_offset   (if NODE_HAS_STR and not NODE_STR_AT_LOC)
+//   str_len      (if NODE_HAS_STR)
+//   symbol       (if NODE_HAS_SYMBOL) index in the symbol records
+//
+// so that a typical node takes 4-6 bytes.
+struct NodeRecord {
+  uint32_t tag;
+  uint32_t num_kids;
+  uint32_t str_offset;  // string, as a range of the source text
+  uint32_t str_len;
+  uint32_t loc_offset;  // location, or NONE
+  uint32_t symbol;      // index in the symbol records, or NONE
+  bool explicit_loc;    // true if the location was set explicitly
+};
+
+// node flags
+const uint8_t NODE_EXPLICIT_LOC = 1;
+const uint8_t NODE_HAS_LOC      = 2;
+const uint8_t NODE_HAS_STR      = 4;
+const uint8_t NODE_STR_AT_LOC   = 8;
+const uint8_t NODE_HAS_SYMBOL   = 16;
+
+static_assert(sizeof(CacheHeader) == 40 && sizeof(SymbolRecord) == 8,
+              "cache records must not contain padding");
+static_assert(AST_LAZY_STATEMENT_LIST - AST_ADD < 256, "AST tags must fit in a byte");
+
+// 64 bit FNV-1a hash
+uint64_t hash_bytes(const void *begin, const void *end) {
+  uint64_t h = 14695981039346656037ULL;
+  for (const unsigned char *p = static_cast<const unsigned char *>(begin); p != end; ++p) {
+    h = (h ^ *p) * 1099511628211ULL;
+  }
+  return h;
+}
+
+uint64_t hash_source(const SourceBuffer &src) {
+  return hash_bytes(src.begin(), src.end());
+}
+
+class CacheWriter {
+private:
+  std::vector<unsigned char> m_buf;
+  uint32_t m_prev_loc;
+
+public:
+  CacheWriter() : m_prev_loc(0) { }
+
+  std::vector<unsigned char> &get_buf() { return m_buf; }
+
+  template<typename T>
+  void write(const T &rec) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(&rec);
+    m_buf.insert(m_buf.end(), p, p + sizeof(T));
+  }
+
+  void write_varint(uint32_t val) {
+    while (val >= 0x80) {
+      m_buf.push_back((unsigned char) (val | 0x80));
+      val >>= 7;
+    }
+    m_buf.push_back((unsigned char) val);
+  }
+
+  void write_node(const NodeRecord &rec) {
+    uint8_t flags = 0;
+    if (rec.explicit_loc) {
+      flags |= NODE_EXPLICIT_LOC;
+    }
+    if (rec.loc_offset != NONE) {
+      flags |= NODE_HAS_LOC;
+    }
+    if (rec.str_len > 0) {
+      flags |= NODE_HAS_STR;
+      if (rec.str_offset == rec.loc_offset) {
+        flags |= NODE_STR_AT_LOC;
+      }
+    }
+    if (rec.symbol != NONE) {
+      flags |= NODE_HAS_SYMBOL;
+    }
+
+    m_buf.push_back((unsigned char) (rec.tag - AST_ADD));
+    m_buf.push_back(flags);
+    write_varint(rec.num_kids);
+    if (flags & NODE_HAS_LOC) {
+      int32_t delta = int32_t(rec.loc_offset - m_prev_loc);
+      write_varint((uint32_t(delta) << 1) ^ uint32_t(delta >> 31));
+      m_prev_loc = rec.loc_offset;
+    }
+    if (flags & NODE_HAS_STR) {
+      if (!(flags & NODE_STR_AT_LOC)) {
+        write_varint(rec.str_offset);
+      }
+      write_varint(rec.str_len);
+    }
+    if (flags & NODE_HAS_SYMBOL) {
+      write_varint(rec.symbol);
+    }
+  }
+};
+
+// Checked sequential reads from the contents of a cache file
+class CacheReader {
+private:
+  const unsigned char *m_pos, *m_end;
+  uint32_t m_prev_loc;
+
+public:
+  CacheReader(const char *begin, const char *end)
+    : m_pos(reinterpret_cast<const unsigned char *>(begin))
+    , m_end(reinterpret_cast<const unsigned char *>(end))
+    , m_prev_loc(0) { }
+
+  bool at_end() const { return m_pos == m_end; }
+
+  template<typename T>
+  bool read(T &rec) {
+    if (size_t(m_end - m_pos) < sizeof(T)) {
+      return false;
+    }
+    memcpy(&rec, m_pos, sizeof(T));
+    m_pos += sizeof(T);
+    return true;
+  }
+
+  bool read_varint(uint32_t &val) {
+    val = 0;
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+      if (m_pos == m_end) {
+        return false;
+      }
+      unsigned char b = *m_pos++;
+      val |= uint32_t(b & 0x7f) << shift;
+      if (!(b & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool read_node(NodeRecord &rec) {
+    if (m_end - m_pos < 2) {
+      return false;
+    }
+    rec.tag = AST_ADD + *m_pos++;
+    uint8_t flags = *m_pos++;
+    rec.explicit_loc = (flags & NODE_EXPLICIT_LOC) != 0;
+    if (!read_varint(rec.num_kids)) {
+      return false;
+    }
+
+    rec.loc_offset = NONE;
+    if (flags & NODE_HAS_LOC) {
+      uint32_t zigzag;
+      if (!read_varint(zigzag)) {
+        return false;
+      }
+      int32_t delta = int32_t(zigzag >> 1) ^ -int32_t(zigzag & 1);
+      rec.loc_offset = m_prev_loc = m_prev_loc + uint32_t(delta);
+    }
+
+    rec.str_offset = rec.str_len = 0;
+    if (flags & NODE_HAS_STR) {
+      if (flags & NODE_STR_AT_LOC) {
+        rec.str_offset = rec.loc_offset;
+      } else if (!read_varint(rec.str_offset)) {
+        return false;
+      }
+      if (!read_varint(rec.str_len)) {
+        return false;
+      }
+    }
+
+    rec.symbol = NONE;
+    if ((flags & NODE_HAS_SYMBOL) && !read_varint(rec.symbol)) {
+      return false;
+    }
+    return true;
+  }
+};
+
+// A Node whose children are still being read
+struct PendingNode {
+  Node *node;
+  uint32_t remaining_kids;
+  uint32_t loc_offset;  // the location the node should end up with
+};
+
+// Rebuild an AST from its cache file contents, returning nullptr
+// if the contents are invalid
+Node *read_ast(CacheReader &in, const CacheHeader &header, unsigned file_id, const SourceBuffer &src,
+              ASTArena &arena) {
+  const char *text = src.begin();
+  uint32_t text_size = header.source_size;
+
+  std::vector<Symbol> symbols(header.num_symbols);
+  for (uint32_t i = 0; i < header.num_symbols; i++) {
+    SymbolRecord rec;
+    if (!in.read(rec) || rec.offset > text_size || rec.len > text_size - rec.offset) {
+      return nullptr;
+    }
+    symbols[i] = SymbolTable::intern(text + rec.offset, rec.len);
+  }
+
+  std::vector<PendingNode> stack;
+  for (uint32_t i = 0; i < header.num_nodes; i++) {
+    NodeRecord rec;
+    if (!in.read_node(rec)
+        || rec.tag > AST_LAZY_STATEMENT_LIST
+        || rec.str_offset > text_size || rec.str_len > text_size - rec.str_offset
+        || (rec.loc_offset != NONE && rec.loc_offset > text_size)
+        || (rec.symbol != NONE && rec.symbol >= header.num_symbols)) {
+      return nullptr;
+    }
+
+    Node *node = arena.new_node(int(rec.tag), std::string_view(text + rec.str_offset, rec.str_len));
+    if (rec.explicit_loc) {
+      node->set_loc(rec.loc_offset == NONE ? Location() : Location(file_id, rec.loc_offset));
+    }
+    if (rec.symbol != NONE) {
+      node->set_symbol(symbols[rec.symbol]);
+    }
+    if (rec.tag == AST_INT_LITERAL) {
+      int value;
+      if (!Parser2::decode_int_literal(node->get_str(), value)) {
+        return nullptr;
+      }
+      node->set_int_value(value);
+    }
+    if (rec.tag == AST_LAZY_STATEMENT_LIST) {
+      Stats::lazy_bodies++;
+    }
+    stack.push_back({ node, rec.num_kids, rec.loc_offset });
+
+    // attach completed nodes to their parents (children are attached
+    // after they are complete, just as the parser does, so that
+    // locations which aren't set explicitly come out the same)
+    while (stack.back().remaining_kids == 0) {
+      Node *done = stack.back().node;
+      uint32_t expected_loc_offset = stack.back().loc_offset;
+      stack.pop_back();
+
+      uint32_t loc_offset = done->get_loc().is_valid() ? done->get_loc().get_offset() : NONE;
+      if (loc_offset != expected_loc_offset) {
+        return nullptr;
+      }
+
+      if (stack.empty()) {
+        // the root must be the last node
+        return (i == header.num_nodes - 1 && in.at_end()) ? done : nullptr;
+      }
+      stack.back().node->append_kid(done);
+      stack.back().remaining_kids--;
+    }
+  }
+
+  return nullptr; // ran out of nodes
+}
+
+}
+
+std::string ASTCache::get_cache_filename(unsigned file_id, unsigned long long hash) {
+  const char *cache_dir = getenv("MINILANG_CACHE_DIR");
+  if (cache_dir != nullptr && cache_dir[0] != '\0') {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.mlc", hash);
+    return std::string(cache_dir) + name;
+  }
+
+  const std::string &filename = SourceFileTable::get(file_id).get_filename();
+  if (filename == "<stdin>") {
+    return "";
+  }
+  return filename + ".mlc";
+}
+
+Node *ASTCache::load(unsigned file_id, bool lazy_bodies, ASTArena &arena) {
+  const SourceBuffer &src = SourceFileTable::get(file_id);
+  uint64_t hash = hash_source(src);
+  std::string cache_filename = get_cache_filename(file_id, hash);
+  if (cache_filename.empty()) {
+    return nullptr;
+  }
+
+  FILE *f = fopen(cache_filename.c_str(), "r");
+  if (f == nullptr) {
+    Stats::ast_cache_misses++;
+    return nullptr;
+  }
+
+  Node *ast = nullptr;
+  try {
+    SourceBuffer cache(f, cache_filename);
+    CacheReader in(cache.begin(), cache.end());
+    CacheHeader header;
+    if (in.read(header)
+        && header.magic == CACHE_MAGIC
+        && header.version == CACHE_VERSION
+        && header.source_hash == hash
+        && header.source_size == src.size()
+        && header.flags == (lazy_bodies ? CACHE_LAZY_BODIES : 0)
+        && header.data_hash == hash_bytes(cache.begin() + sizeof(CacheHeader), cache.end())) {
+      ast = read_ast(in, header, file_id, src, arena);
+    }
+  } catch (RuntimeError &ex) {
+    // unreadable cache file: just parse the source
+  }
+  fclose(f);
+
+  if (ast != nullptr) {
+    Stats::ast_cache_hits++;
+  } else {
+    Stats::ast_cache_misses++;
+  }
+  return ast;
+}
+
+void ASTCache::store(Node *ast, unsigned file_id, bool lazy_bodies) {
+  const SourceBuffer &src = SourceFileTable::get(file_id);
+  uint64_t hash = hash_source(src);
+  std::string cache_filename = get_cache_filename(file_id, hash);
+  if (cache_filename.empty()) {
+    return;
+  }
+
+  std::vector<SymbolRecord> symbols;
+  std::unordered_map<Symbol, uint32_t> symbol_index;
+  std::vector<NodeRecord> nodes;
+
+  // preorder traversal, using an explicit stack since the AST may be deep
+  std::vector<Node *> stack(1, ast);
+  while (!stack.empty()) {
+    Node *n = stack.back();
+    stack.pop_back();
+
+    NodeRecord rec;
+    std::string_view str = n->get_str();
+    rec.tag = uint32_t(n->get_tag());
+    rec.num_kids = n->get_num_kids();
+    if (str.empty()) {
+      rec.str_offset = rec.str_len = 0;
+    } else {
+      // all strings are in the source text
+      rec.str_offset = uint32_t(str.data() - src.begin());
+      rec.str_len = uint32_t(str.size());
+    }
+    rec.loc_offset = n->get_loc().is_valid() ? n->get_loc().get_offset() : NONE;
+    rec.symbol = NONE;
+    if (n->get_symbol() != NO_SYMBOL) {
+      auto i = symbol_index.find(n->get_symbol());
+      if (i == symbol_index.end()) {
+        // a node's symbol is always its string, which is a name in the source text
+        i = symbol_index.insert({ n->get_symbol(), uint32_t(symbols.size()) }).first;
+        symbols.push_back({ rec.str_offset, rec.str_len });
+      }
+      rec.symbol = i->second;
+    }
+    rec.explicit_loc = n->has_explicit_loc();
+    nodes.push_back(rec);
+
+    for (unsigned i = n->get_num_kids(); i > 0; i--) {
+      stack.push_back(n->get_kid(i - 1));
+    }
+  }
+
+  CacheHeader header;
+  header.magic = CACHE_MAGIC;
+  header.version = CACHE_VERSION;
+  header.source_hash = hash;
+  header.data_hash = 0; // filled in below
+  header.source_size = uint32_t(src.size());
+  header.flags = lazy_bodies ? CACHE_LAZY_BODIES : 0;
+  header.num_symbols = uint32_t(symbols.size());
+  header.num_nodes = uint32_t(nodes.size());
+
+  CacheWriter out;
+  out.write(header);
+  for (auto i = symbols.begin(); i != symbols.end(); ++i) {
+    out.write(*i);
+  }
+  for (auto i = nodes.begin(); i != nodes.end(); ++i) {
+    out.write_node(*i);
+  }
+
+  // write a temporary file and rename it, so that concurrent
+  // runs never see a partially-written cache file
+  std::string tmp_filename = cache_filename + ".tmp" + std::to_string(getpid());
+  FILE *f = fopen(tmp_filename.c_str(), "w");
+  if (f == nullptr) {
+    return;
+  }
+  std::vector<unsigned char> &buf = out.get_buf();
+  uint64_t data_hash = hash_bytes(buf.data() + sizeof(CacheHeader), buf.data() + buf.size());
+  memcpy(buf.data() + offsetof(CacheHeader, data_hash), &data_hash, sizeof(data_hash));
+  bool ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || rename(tmp_filename.c_str(), cache_filename.c_str()) != 0) {
+    remove(tmp_filename.c_str());
+  }
+}
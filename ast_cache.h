@@ -0,0 +1,45 @@
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include <string>
+class Node;
+class ASTArena;
+
+// The ASTCache saves the AST of a source file in a binary cache file,
+// so that later runs on the same source text can load the AST instead
+// of lexing and parsing.  A cache file is stored next to the source
+// file (with ".mlc" appended to its name), or, if the MINILANG_CACHE_DIR
+// environment variable is set, in that directory under a name derived
+// from a hash of the source text.
+//
+// Node strings and Locations refer to the source text (which is
+// always read, to check that the cache file is up to date), so the
+// cache file only needs to record offsets into the source text.
+// The format is a fixed-size header and symbol table in the machine's
+// byte order (a file written with the other byte order fails the magic
+// number check), followed by a compact preorder encoding of the nodes
+// (see NodeRecord in ast_cache.cpp), so that loading it is a single
+// bounds-checked walk over the mapped file.  Note that CACHE_VERSION
+// must be changed whenever the format or the AST node tags change.
+// If the cache file is missing, out of date, or invalid in any way,
+// the AST is simply not loaded.
+
+class ASTCache {
+public:
+  // Load the cached AST of a file in the SourceFileTable into the
+  // given arena, returning nullptr if there is no usable cache file.
+  // lazy_bodies must be the same as the parser setting used to build
+  // the cached AST.
+  static Node *load(unsigned file_id, bool lazy_bodies, ASTArena &arena);
+
+  // Save the AST of a file in the SourceFileTable.  Failure
+  // to write the cache file is not an error.
+  static void store(Node *ast, unsigned file_id, bool lazy_bodies);
+
+private:
+  // Get the name of the cache file for a source file with the
+  // given hash, or an empty string if the file can't be cached
+  static std::string get_cache_filename(unsigned file_id, unsigned long long hash);
+};
+
+#endif // AST_CACHE_H
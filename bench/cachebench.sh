@@ -0,0 +1,24 @@
+#!/bin/sh
+# AST cache benchmark: runs generated programs with and without the
+# AST cache (minilang -c), and reports the run times without a cache,
+# with a warm cache, and the size of the cache file.
+#
+# usage: cachebench.sh <minilang executable>
+
+. "$(dirname "$0")/common.sh"
+
+minilang=${1:-./minilang}
+
+MINILANG_CACHE_DIR="$BENCH_TMP/cache"
+export MINILANG_CACHE_DIR
+rm -rf "$MINILANG_CACHE_DIR"
+mkdir -p "$MINILANG_CACHE_DIR"
+
+echo "AST cache:"
+for input in "library 5000" "mixed 50000"; do
+  f=$(gen_input $input)
+  "$minilang" -c "$f" > /dev/null 2>&1
+  echo "  $(basename "$f") ($(file_mb "$f") MB, cache $(file_mb "$MINILANG_CACHE_DIR"/*.mlc) MB):"
+  echo "    run time:    no cache $(run_time "$minilang" "$f") s, warm cache $(run_time "$minilang" -c "$f") s"
+  rm -f "$MINILANG_CACHE_DIR"/*.mlc
+done
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Closure compiler benchmark: runs loop-heavy and call-heavy programs
+# with each execution engine: evaluating the AST, running it compiled
+# to a tree of ExecNodes (minilang -k), and running it compiled for
+# the stack and register virtual machines (minilang -b and -r).
+#
+# usage: closurebench.sh <minilang executable>
+
+. "$(dirname "$0")/common.sh"
+
+minilang=${1:-./minilang}
+
+echo "closure compiler:"
+for input in "arith 3000000" "deeploop 2000000" "loop 1000000" "fib 27"; do
+  f=$(gen_input $input)
+  echo "  $(basename "$f"):"
+  echo "    run time:    Node $(run_time "$minilang" "$f") s, closures $(run_time "$minilang" -k "$f") s, bytecode $(run_time "$minilang" -b "$f") s, register $(run_time "$minilang" -r "$f") s"
+done
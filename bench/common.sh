@@ -0,0 +1,40 @@
+# Helper functions shared by the benchmark scripts.
+# Source this file; don't run it directly.
+
+# Directory holding the generated inputs (reused between runs)
+BENCH_TMP=${BENCH_TMP:-/tmp/minilang-bench}
+mkdir -p "$BENCH_TMP"
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+
+# gen_input <kind> <count>: print the path of a generated input file,
+# creating it if necessary
+gen_input() {
+  local f="$BENCH_TMP/$1-$2.txt"
+  if [ ! -s "$f" ]; then
+    sh "$BENCH_DIR/genprog.sh" "$1" "$2" > "$f"
+  fi
+  echo "$f"
+}
+
+# run_time <command...>: run a command (discarding its output) and
+# print its wall clock time in seconds.  The best of $BENCH_REPS runs
+# is reported.
+run_time() {
+  local best="" i start end t
+  for i in $(seq ${BENCH_REPS:-3}); do
+    start=$(date +%s%N)
+    "$@" > /dev/null 2>&1
+    end=$(date +%s%N)
+    t=$(( (end - start) / 1000 ))
+    if [ -z "$best" ] || [ $t -lt $best ]; then
+      best=$t
+    fi
+  done
+  awk -v us=$best 'BEGIN { printf "%.3f", us / 1e6 }'
+}
+
+# file_mb <file>: print the size of a file in megabytes
+file_mb() {
+  awk -v b=$(wc -c < "$1") 'BEGIN { printf "%.1f", b / 1048576 }'
+}
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Dispatch benchmark: runs tight while loops on both virtual machines
+# (minilang -b and -r), built with threaded-code dispatch (minilang)
+# and with switch dispatch (minilang-switch), and reports the average
+# time per instruction executed.
+#
+# usage: dispatchbench.sh <minilang executable> <minilang-switch executable>
+
+. "$(dirname "$0")/common.sh"
+
+minilang=${1:-./minilang}
+minilang_switch=${2:-./minilang-switch}
+
+# instructions <command...>: print the number of instructions executed
+# by a run
+instructions() {
+  "$@" -s 2>&1 > /dev/null | awk '/^execution:/ { print $6 }'
+}
+
+# per_instruction <engine flag> <file>: print the run time, and the
+# time per instruction, of each executable
+per_instruction() {
+  local n t_threaded t_switch
+  n=$(instructions "$minilang" $1 "$2")
+  t_threaded=$(run_time "$minilang" $1 "$2")
+  t_switch=$(run_time "$minilang_switch" $1 "$2")
+  awk -v n=$n -v t=$t_threaded -v s=$t_switch 'BEGIN {
+    printf "%.1fM instructions, threaded %.3f s (%.2f ns/instruction), switch %.3f s (%.2f ns/instruction)",
+           n / 1e6, t, t * 1e9 / n, s, s * 1e9 / n
+  }'
+}
+
+echo "instruction dispatch:"
+for input in "spin 20000000" "arith 3000000"; do
+  f=$(gen_input $input)
+  echo "  $(basename "$f"):"
+  echo "    bytecode:    $(per_instruction -b "$f")"
+  echo "    register:    $(per_instruction -r "$f")"
+done
@@ -0,0 +1,15 @@
+#!/bin/sh
+# Expression parsing benchmark: parses single expressions with an
+# increasing number of operands, and reports the parser's time and
+# stack use.  The stack use should not grow with the expression length.
+#
+# usage: exprbench.sh  (run "make bench/parsespeed" first)
+
+. "$(dirname "$0")/common.sh"
+
+echo "parsing long expressions:"
+for count in 1000 10000 100000 1000000; do
+  f=$(gen_input longexpr $count)
+  printf "  %8d operands: " $count
+  "$BENCH_DIR/parsespeed" "$f" || echo "failed"
+done
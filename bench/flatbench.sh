@@ -0,0 +1,23 @@
+#!/bin/sh
+# Flat AST benchmark: compares walking the AST as linked Nodes with
+# walking a FlatAST, first with a bare preorder traversal (walkspeed)
+# and then by running a loop-heavy program with and without
+# minilang -f.
+#
+# usage: flatbench.sh <minilang executable>  (run "make bench/walkspeed" first)
+
+. "$(dirname "$0")/common.sh"
+
+minilang=${1:-./minilang}
+
+echo "flat AST:"
+for input in "mixed 200000" "longexpr 1000000"; do
+  f=$(gen_input $input)
+  printf "  $(basename "$f") ($(file_mb "$f") MB): "
+  "$BENCH_DIR/walkspeed" "$f" || echo "failed"
+done
+for input in "loop 1000000"; do
+  f=$(gen_input $input)
+  echo "  $(basename "$f"):"
+  echo "    run time:    Node $(run_time "$minilang" "$f") s, flat $(run_time "$minilang" -f "$f") s"
+done
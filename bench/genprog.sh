@@ -0,0 +1,100 @@
+#!/bin/sh
+# Generate a (large) minilang program for benchmarking.
+#
+# usage: genprog.sh <kind> <count>
+#
+# Kinds:
+#   mixed   count statements of typical straight-line code and loops
+#   idents  count statements dominated by long identifiers
+#   longexpr  a single expression statement with count operands
+#   nested  count levels of nested if statements
+#   library count functions, only two of which are called
+#   loop    a loop running count iterations of arithmetic and calls
+#   deeploop  four nested loops running count iterations in all, with
+#           the innermost loop using variables from every level
+#   fib     a recursive computation of the count'th Fibonacci number
+#   arith   a function whose loop runs count iterations of arithmetic
+#           on its local variables
+#   spin    a function whose loop runs count iterations doing nothing
+#           but counting
+#
+# The output is deterministic, so the same arguments always produce
+# the same program.
+
+kind=$1
+count=$2
+
+if [ -z "$kind" ] || [ -z "$count" ]; then
+  echo "usage: genprog.sh <kind> <count>" 1>&2
+  exit 1
+fi
+
+awk -v kind="$kind" -v count="$count" '
+function mixed(i) {
+  if (i % 10 == 0) {
+    printf "var v%d;\n", i
+    printf "v%d = %d;\n", i, i % 97
+  } else if (i % 10 == 5) {
+    printf "if (total < %d) {\n  total = total + 1;\n} else {\n  total = total - 1;\n}\n", i
+  } else if (i % 10 == 7) {
+    printf "counter = 0;\nwhile (counter < 3) {\n  counter = counter + 1;\n}\n"
+  } else {
+    printf "total = (total * %d + counter - %d) / 2 >= total && counter != %d;\n", i % 13 + 1, i % 7, i % 5
+  }
+}
+function idents(i) {
+  printf "someRatherLongVariableName = anotherRatherLongVariableName + yetAnotherLongIdentifier%d * whileLoopCounterValue;\n", i % 50
+}
+BEGIN {
+  if (kind == "mixed") {
+    print "var total;\nvar counter;\ntotal = 0;\ncounter = 0;"
+    for (i = 0; i < count; i++) mixed(i)
+    print "total;"
+  } else if (kind == "idents") {
+    print "var someRatherLongVariableName;\nvar anotherRatherLongVariableName;\nvar whileLoopCounterValue;"
+    for (i = 0; i < 50; i++) printf "var yetAnotherLongIdentifier%d;\n", i
+    for (i = 0; i < count; i++) idents(i)
+  } else if (kind == "longexpr") {
+    print "var total;\ntotal = 1;"
+    printf "total = total"
+    for (i = 0; i < count; i++) printf " %s %d", substr("+*-/", i % 4 + 1, 1), i % 9 + 1
+    print ";"
+  } else if (kind == "library") {
+    print "var total;\ntotal = 0;"
+    for (i = 0; i < count; i++) {
+      printf "function lib%d(a, b) {\n  var i;\n  i = 0;\n", i
+      printf "  while (i < a) {\n    if (i * %d > b) {\n      b = b + i / 2;\n    } else {\n      b = b - (i + %d);\n    }\n    i = i + 1;\n  }\n", i % 7 + 1, i % 5
+      printf "  b * 2 + a;\n}\n"
+    }
+    printf "total = lib0(10, 3) + lib%d(20, 5);\ntotal;\n", count - 1
+  } else if (kind == "loop") {
+    print "var total;\nvar i;\ntotal = 0;\ni = 0;"
+    print "function step(a, b) {\n  var t;\n  t = a * 3 + b - a / 7;\n  if (t > 100000) {\n    t = t / 4;\n  }\n  t;\n}"
+    printf "while (i < %d) {\n  total = step(total, i) + (i * 2 - i / 3) / 5;\n", count
+    print "  if (total > 1000000 || total < 0 - 1000000) {\n    total = total / 2;\n  }\n  i = i + 1;\n}\ntotal;"
+  } else if (kind == "deeploop") {
+    print "var total;\nvar a;\ntotal = 0;\na = 0;"
+    printf "while (a < %d) {\n  var b;\n  b = 0;\n", int(count / 1000)
+    print "  while (b < 10) {\n    var c;\n    c = 0;\n    while (c < 10) {\n      var d;\n      d = 0;"
+    print "      while (d < 10) {\n        total = total + c * d - b + a / 100;\n        d = d + 1;\n      }"
+    print "      c = c + 1;\n    }\n    b = b + 1;\n  }\n  a = a + 1;\n}\ntotal;"
+  } else if (kind == "fib") {
+    print "function fib(n) {\n  var r;\n  r = n;\n  if (n > 1) {\n    r = fib(n - 1) + fib(n - 2);\n  }\n  r;\n}"
+    printf "fib(%d);\n", count
+  } else if (kind == "arith") {
+    print "function arith(n) {\n  var i;\n  var x;\n  var y;\n  i = 0;\n  x = 1;\n  y = 0;"
+    print "  while (i < n) {\n    x = (x * 7 + i) / 3 - y;\n    if (x > 1000 || x < 0 - 1000) {\n      x = x / 2;\n    }"
+    print "    y = y + x / 5 - i / 9;\n    i = i + 1;\n  }\n  x + y;\n}"
+    printf "arith(%d);\n", count
+  } else if (kind == "spin") {
+    print "function spin(n) {\n  var i;\n  i = 0;\n  while (i < n) {\n    i = i + 1;\n  }\n  i;\n}"
+    printf "spin(%d);\n", count
+  } else if (kind == "nested") {
+    print "var total;\ntotal = 0;"
+    for (i = 0; i < count; i++) printf "if ((total + %d) * 2 > total) {\n  total = total + 1;\n", i % 9
+    for (i = 0; i < count; i++) printf "}\n"
+  } else {
+    print "genprog.sh: unknown kind " kind > "/dev/stderr"
+    exit 1
+  }
+}'
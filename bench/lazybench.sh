@@ -0,0 +1,22 @@
+#!/bin/sh
+# Lazy function body benchmark: runs a generated program defining
+# many functions, only two of which are called, with and without
+# lazy parsing of function bodies (minilang -z), and reports the
+# run times and the number of AST nodes built by the parser.
+#
+# usage: lazybench.sh <minilang executable>  (run "make bench/parsespeed" first)
+
+. "$(dirname "$0")/common.sh"
+
+minilang=${1:-./minilang}
+
+echo "lazy function bodies:"
+for input in "library 5000" "library 50000"; do
+  f=$(gen_input $input)
+  echo "  $(basename "$f") ($(file_mb "$f") MB):"
+  echo "    run time:    eager $(run_time "$minilang" "$f") s, lazy $(run_time "$minilang" -z "$f") s"
+  for mode in "" "-z"; do
+    printf "    "
+    "$BENCH_DIR/parsespeed" $mode "$f" || echo "failed"
+  done
+done
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Lexer throughput benchmark: reports MB/s for "minilang -l" on large
+# generated inputs.  The "idents" input is dominated by identifiers,
+# so it mostly measures identifier and keyword recognition.
+#
+# usage: lexbench.sh <minilang binary> [<other minilang binary>...]
+#
+# Pass several binaries (e.g., builds of two different revisions)
+# to compare them on the same inputs.
+#
+# If bench/lexspeed has been built, the lexer alone is also timed
+# (without printing tokens) with each character-scanning
+# implementation (see lexscan.h), on the same inputs.
+
+. "$(dirname "$0")/common.sh"
+
+if [ $# -eq 0 ]; then
+  set -- ./minilang
+fi
+
+echo "lexer throughput (minilang -l):"
+for input in "mixed 50000" "mixed 200000" "idents 100000"; do
+  f=$(gen_input $input)
+  mb=$(file_mb "$f")
+  for bin in "$@"; do
+    t=$(run_time "$bin" -l "$f")
+    awk -v bin="$bin" -v mb=$mb -v t=$t -v f="$(basename "$f")" \
+      'BEGIN { printf "  %-28s %-20s %7.1f MB %8.3f s %8.1f MB/s\n", bin, f, mb, t, mb / t }'
+  done
+done
+
+if [ -x "$BENCH_DIR/lexspeed" ]; then
+  echo
+  echo "lexer only (bench/lexspeed), by scanning implementation:"
+  for input in "mixed 200000" "idents 100000"; do
+    f=$(gen_input $input)
+    echo "  $(basename "$f"):"
+    for impl in scalar sse2 avx2; do
+      MINILANG_SCAN=$impl "$BENCH_DIR/lexspeed" "$f" ${BENCH_REPS:-3} 2> /dev/null | sed 's/^/    /'
+    done
+  done
+fi
@@ -0,0 +1,62 @@
+// Lexer throughput microbenchmark: tokenizes a file several times
+// (without printing anything) and reports the best MB/s.
+// The character-scanning implementation can be selected with
+// the MINILANG_SCAN environment variable (see lexscan.h).
+// If a number of threads greater than 1 is given, the input is
+// tokenized with Lexer::tokenize_parallel().
+//
+// usage: lexspeed <file> [<repetitions> [<threads>]]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "lexer.h"
+#include "exceptions.h"
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: lexspeed <file> [<repetitions> [<threads>]]\n");
+    return 1;
+  }
+  const char *filename = argv[1];
+  int reps = (argc > 2) ? atoi(argv[2]) : 5;
+  int num_threads = (argc > 3) ? atoi(argv[3]) : 1;
+
+  try {
+    double best = -1.0;
+    unsigned long ntokens = 0, nbytes = 0;
+    for (int i = 0; i < reps; i++) {
+      FILE *in = fopen(filename, "r");
+      if (!in) {
+        RuntimeError::raise("Could not open input file '%s'", filename);
+      }
+      fseek(in, 0, SEEK_END);
+      nbytes = (unsigned long) ftell(in);
+      rewind(in);
+
+      auto start = std::chrono::steady_clock::now();
+      Lexer lexer(in, filename);
+      if (num_threads > 1) {
+        lexer.tokenize_parallel(unsigned(num_threads));
+      }
+      ntokens = 0;
+      while (lexer.peek() != nullptr) {
+        lexer.next();
+        ntokens++;
+      }
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+      if (best < 0.0 || elapsed.count() < best) {
+        best = elapsed.count();
+      }
+    }
+
+    double mb = nbytes / 1048576.0;
+    printf("%-8s %3d thread(s) %10lu tokens %8.1f MB %8.3f s %8.1f MB/s\n",
+           LexScan::get().name, num_threads, ntokens, mb, best, mb / best);
+  } catch (BaseException &ex) {
+    fprintf(stderr, "Error: %s\n", ex.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Parallel lexing scaling benchmark: tokenizes a large generated
+# program with Lexer::tokenize_parallel() using 1, 2, 4, ... threads
+# (up to the number of cores, or $BENCH_MAX_THREADS), and reports
+# throughput and speedup over the single-threaded lexer.
+#
+# usage: parlexbench.sh  (run "make bench/lexspeed" first)
+
+. "$(dirname "$0")/common.sh"
+
+max_threads=${BENCH_MAX_THREADS:-$(nproc 2> /dev/null || echo 4)}
+
+for input in "mixed 800000"; do
+  f=$(gen_input $input)
+  echo "parallel lexing of $(basename "$f") ($(file_mb "$f") MB), $(nproc 2> /dev/null) core(s):"
+  base=""
+  n=1
+  while [ $n -le $max_threads ]; do
+    line=$("$BENCH_DIR/lexspeed" "$f" ${BENCH_REPS:-3} $n)
+    t=$(echo "$line" | awk '{ print $(NF-3) }')
+    if [ -z "$base" ]; then
+      base=$t
+    fi
+    echo "$line" | awk -v base=$base -v t=$t '{ printf "  %s  speedup %.2fx\n", $0, base / t }'
+    n=$((n * 2))
+  done
+done
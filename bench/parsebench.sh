@@ -0,0 +1,24 @@
+#!/bin/sh
+# Parser benchmark: compares the throughput and stack use of the
+# recursive parser and the explicit-stack parser (minilang -i).
+# The deeply nested input is only parsed with the explicit stack,
+# since it would overflow the native stack of the recursive parser.
+#
+# usage: parsebench.sh  (run "make bench/parsespeed" first)
+
+. "$(dirname "$0")/common.sh"
+
+echo "recursive vs. explicit-stack parsing:"
+for input in "mixed 200000" "nested 2000"; do
+  f=$(gen_input $input)
+  echo "  $(basename "$f") ($(file_mb "$f") MB):"
+  for mode in "" "-s"; do
+    printf "    "
+    "$BENCH_DIR/parsespeed" $mode "$f" || echo "failed"
+  done
+done
+
+f=$(gen_input nested 1000000)
+echo "  $(basename "$f") ($(file_mb "$f") MB):"
+printf "    "
+"$BENCH_DIR/parsespeed" -s "$f" || echo "failed"
@@ -0,0 +1,111 @@
+// Parser microbenchmark: parses a file once and reports the time
+// taken, the stack high-water mark of the process (VmStk, which
+// only grows), so that stack use can be compared across inputs,
+// and the size of the AST's arena and the time taken to free it.
+// With -s, the file is parsed with an explicit parse stack
+// (Parser2::set_use_stack()) and no nesting depth limit.
+// With -z, function bodies are parsed lazily (and so not at all).
+//
+// usage: parsespeed [-s] [-z] <file>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+#include "lexer.h"
+#include "parser2.h"
+#include "ast_arena.h"
+#include "exceptions.h"
+
+namespace {
+
+// Get the size of the process's stack mapping in KB,
+// or -1 if it can't be determined
+long get_stack_kb() {
+  FILE *f = fopen("/proc/self/status", "r");
+  if (f == nullptr) {
+    return -1;
+  }
+  long kb = -1;
+  char line[256];
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    if (strncmp(line, "VmStk:", 6) == 0) {
+      kb = atol(line + 6);
+      break;
+    }
+  }
+  fclose(f);
+  return kb;
+}
+
+// Count the nodes in a tree (iteratively, since Node::preorder()
+// would recurse to the depth of the tree)
+unsigned long count_nodes(Node *root) {
+  unsigned long count = 0;
+  std::vector<Node *> stack(1, root);
+  while (!stack.empty()) {
+    Node *n = stack.back();
+    stack.pop_back();
+    count++;
+    n->each_child([&stack](Node *kid) { stack.push_back(kid); });
+  }
+  return count;
+}
+
+}
+
+int main(int argc, char **argv) {
+  bool use_stack = false, lazy_bodies = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "sz")) != -1) {
+    if (opt == 's') {
+      use_stack = true;
+    } else if (opt == 'z') {
+      lazy_bodies = true;
+    } else {
+      optind = argc; // force usage message
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "usage: parsespeed [-s] [-z] <file>\n");
+    return 1;
+  }
+  const char *filename = argv[optind];
+
+  try {
+    FILE *in = fopen(filename, "r");
+    if (!in) {
+      RuntimeError::raise("Could not open input file '%s'", filename);
+    }
+    fseek(in, 0, SEEK_END);
+    double mb = ftell(in) / 1048576.0;
+    rewind(in);
+
+    long stack_before = get_stack_kb();
+    auto start = std::chrono::steady_clock::now();
+    ASTArena *arena = new ASTArena();
+    Parser2 parser(new Lexer(in, filename), arena);
+    parser.set_use_stack(use_stack);
+    parser.set_max_depth(0);
+    parser.set_lazy_function_bodies(lazy_bodies);
+    Node *ast = parser.parse();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    long stack_after = get_stack_kb();
+
+    unsigned long num_nodes = count_nodes(ast);
+    double arena_mb = arena->get_total_size() / 1048576.0;
+
+    start = std::chrono::steady_clock::now();
+    delete arena;
+    std::chrono::duration<double> free_elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("%-9s%s %10lu nodes %8.3f s %8.1f MB/s  stack %6ld KB (%ld KB before parsing)  arena %6.1f MB freed in %.3f ms\n",
+           use_stack ? "stack" : "recursive", lazy_bodies ? " lazy" : "     ", num_nodes, elapsed.count(),
+           mb / elapsed.count(), stack_after, stack_before, arena_mb, free_elapsed.count() * 1000);
+  } catch (BaseException &ex) {
+    fprintf(stderr, "Error: %s\n", ex.what());
+    return 1;
+  }
+  return 0;
+}
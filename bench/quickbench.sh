@@ -0,0 +1,28 @@
+#!/bin/sh
+# Quickening benchmark: runs loop-heavy and call-heavy programs by
+# evaluating the AST (as Nodes and as a FlatAST), and reports how many
+# binary operator nodes were specialized for int operands (and later
+# de-specialized), the number of AST nodes evaluated, and the run time.
+#
+# usage: quickbench.sh <minilang executable>
+
+. "$(dirname "$0")/common.sh"
+
+minilang=${1:-./minilang}
+
+# quickening <file>: print the quickening and work counters of a run
+quickening() {
+  "$minilang" -s "$1" 2>&1 > /dev/null | awk '
+    /^execution:/  { nodes = $2 }
+    /^quickening:/ { specialized = $2; despecialized = $5 }
+    END { printf "%d nodes specialized, %d de-specialized, %.1fM nodes evaluated",
+                 specialized, despecialized, nodes / 1e6 }'
+}
+
+echo "quickening:"
+for input in "arith 3000000" "deeploop 2000000" "loop 1000000" "fib 27"; do
+  f=$(gen_input $input)
+  echo "  $(basename "$f"):"
+  echo "    quickening:  $(quickening "$f")"
+  echo "    run time:    Node $(run_time "$minilang" "$f") s, flat $(run_time "$minilang" -f "$f") s"
+done
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Register VM benchmark: runs loop-heavy and call-heavy programs by
+# evaluating the AST, by compiling it to stack bytecode (minilang -b),
+# and by compiling it to three-address register code (minilang -r),
+# and reports the work done by each (AST nodes evaluated, or
+# instructions executed) as well as the run time.
+#
+# usage: regbench.sh <minilang executable>
+
+. "$(dirname "$0")/common.sh"
+
+minilang=${1:-./minilang}
+
+# work_done <args...>: print the number of AST nodes evaluated plus
+# the number of instructions executed by a run (only one is nonzero)
+work_done() {
+  "$minilang" -s "$@" 2>&1 > /dev/null |
+    awk '/^execution:/ { printf "%.1fM", ($2 + $6) / 1e6 }'
+}
+
+echo "register VM:"
+for input in "arith 3000000" "deeploop 2000000" "loop 1000000" "fib 27"; do
+  f=$(gen_input $input)
+  echo "  $(basename "$f"):"
+  echo "    work:        Node $(work_done "$f") nodes, bytecode $(work_done -b "$f") instructions, register $(work_done -r "$f") instructions"
+  echo "    run time:    Node $(run_time "$minilang" "$f") s, bytecode $(run_time "$minilang" -b "$f") s, register $(run_time "$minilang" -r "$f") s"
+done
@@ -0,0 +1,17 @@
+#!/bin/sh
+# Variable access benchmark: runs programs whose time is dominated
+# by variable references and assignments, including references from
+# deeply nested loops to variables defined in the enclosing scopes.
+#
+# usage: varbench.sh <minilang executable>
+
+. "$(dirname "$0")/common.sh"
+
+minilang=${1:-./minilang}
+
+echo "variable access:"
+for input in "deeploop 2000000" "loop 1000000"; do
+  f=$(gen_input $input)
+  echo "  $(basename "$f"):"
+  echo "    run time:    Node $(run_time "$minilang" "$f") s, flat $(run_time "$minilang" -f "$f") s"
+done
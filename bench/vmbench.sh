@@ -0,0 +1,17 @@
+#!/bin/sh
+# Bytecode VM benchmark: runs loop-heavy and call-heavy programs by
+# evaluating the AST (as Nodes and as a FlatAST) and by compiling
+# it to bytecode (minilang -b).
+#
+# usage: vmbench.sh <minilang executable>
+
+. "$(dirname "$0")/common.sh"
+
+minilang=${1:-./minilang}
+
+echo "bytecode VM:"
+for input in "deeploop 2000000" "loop 1000000" "fib 27"; do
+  f=$(gen_input $input)
+  echo "  $(basename "$f"):"
+  echo "    run time:    Node $(run_time "$minilang" "$f") s, flat $(run_time "$minilang" -f "$f") s, bytecode $(run_time "$minilang" -b "$f") s"
+done
@@ -0,0 +1,80 @@
+// Tree walking microbenchmark: parses a file, then repeatedly walks
+// the whole AST in preorder (looking at each node's tag, symbol and
+// children, as the interpreter does) both as Nodes and as a FlatAST,
+// and reports the number of nodes visited per second for each.
+//
+// usage: walkspeed <file> [repetitions]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "lexer.h"
+#include "parser2.h"
+#include "ast_arena.h"
+#include "flat_ast.h"
+#include "exceptions.h"
+
+namespace {
+
+// Walk a tree (NodeRef is Node * or FlatNode) with an explicit
+// stack, returning a checksum so the walk can't be optimized away
+template<typename NodeRef>
+unsigned long walk(NodeRef root, std::vector<NodeRef> &stack) {
+  unsigned long sum = 0;
+  stack.clear();
+  stack.push_back(root);
+  while (!stack.empty()) {
+    NodeRef n = stack.back();
+    stack.pop_back();
+    sum += unsigned(n->get_tag()) + n->get_symbol();
+    for (unsigned i = n->get_num_kids(); i > 0; i--) {
+      stack.push_back(n->get_kid(i - 1));
+    }
+  }
+  return sum;
+}
+
+template<typename NodeRef>
+void time_walks(const char *name, NodeRef root, unsigned long num_nodes, int reps) {
+  std::vector<NodeRef> stack;
+  unsigned long sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < reps; i++) {
+    sum += walk(root, stack);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  printf("  %-6s %8.3f s %8.1f Mnodes/s  (checksum %lu)\n", name, elapsed.count(),
+         num_nodes * double(reps) / elapsed.count() / 1e6, sum);
+}
+
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: walkspeed <file> [repetitions]\n");
+    return 1;
+  }
+  const char *filename = argv[1];
+  int reps = (argc == 3) ? atoi(argv[2]) : 10;
+
+  try {
+    FILE *in = fopen(filename, "r");
+    if (!in) {
+      RuntimeError::raise("Could not open input file '%s'", filename);
+    }
+
+    ASTArena arena;
+    Parser2 parser(new Lexer(in, filename), &arena);
+    Node *ast = parser.parse();
+    FlatAST flat_ast(ast);
+
+    printf("%u nodes, %d walks:\n", flat_ast.get_num_nodes(), reps);
+    time_walks("Node", ast, flat_ast.get_num_nodes(), reps);
+    time_walks("flat", flat_ast.get_root(), flat_ast.get_num_nodes(), reps);
+  } catch (BaseException &ex) {
+    fprintf(stderr, "Error: %s\n", ex.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef BINARY_OP_H
+#define BINARY_OP_H
+
+#include "ast.h"
+#include "location.h"
+#include "exceptions.h"
+#include "value.h"
+
+// The binary operators on ints, for code which is specialized for each
+// operator: BinaryOp<AST_ADD>::apply(l, r, loc) computes l + r, and so
+// on.  The comparisons produce 1 if they're true, 0 if not.  The
+// location is where a division by zero is reported.
+template<int Tag>
+struct BinaryOp;
+
+template<> struct BinaryOp<AST_ADD> {
+  static int apply(int l, int r, const Location &) { return l + r; }
+};
+template<> struct BinaryOp<AST_SUB> {
+  static int apply(int l, int r, const Location &) { return l - r; }
+};
+template<> struct BinaryOp<AST_MULTIPLY> {
+  static int apply(int l, int r, const Location &) { return l * r; }
+};
+template<> struct BinaryOp<AST_DIVIDE> {
+  static int apply(int l, int r, const Location &loc) {
+    if (r == 0) {
+      EvaluationError::raise(loc, "Division by zero.");
+    }
+    return l / r;
+  }
+};
+template<> struct BinaryOp<AST_LESS> {
+  static int apply(int l, int r, const Location &) { return l < r ? 1 : 0; }
+};
+template<> struct BinaryOp<AST_LESS_EQUAL> {
+  static int apply(int l, int r, const Location &) { return l <= r ? 1 : 0; }
+};
+template<> struct BinaryOp<AST_GREATER> {
+  static int apply(int l, int r, const Location &) { return l > r ? 1 : 0; }
+};
+template<> struct BinaryOp<AST_GREATER_EQUAL> {
+  static int apply(int l, int r, const Location &) { return l >= r ? 1 : 0; }
+};
+template<> struct BinaryOp<AST_EQUAL> {
+  static int apply(int l, int r, const Location &) { return l == r ? 1 : 0; }
+};
+template<> struct BinaryOp<AST_NOT_EQUAL> {
+  static int apply(int l, int r, const Location &) { return l != r ? 1 : 0; }
+};
+
+// Apply one of the operators (Op is BinaryOp<tag>) to Values, raising
+// an error at the given location if they aren't both ints.
+template<typename Op>
+Value apply_binary_op(const Value &left, const Value &right, const Location &loc) {
+  if (!left.is_int() || !right.is_int()) {
+    EvaluationError::raise(loc, "Operand must be an integer.");
+  }
+  return Value(Op::apply(left.get_ival(), right.get_ival(), loc));
+}
+
+#endif // BINARY_OP_H
@@ -0,0 +1,345 @@
+#include <cassert>
+#include <algorithm>
+#include "ast.h"
+#include "node.h"
+#include "exceptions.h"
+#include "environment.h"
+#include "function.h"
+#include "bytecode.h"
+
+namespace {
+
+// The effect of each instruction on the depth of the operand stack
+// (for OP_AND and OP_OR, when the jump isn't taken)
+int stack_effect(Opcode op, int a) {
+  switch (op) {
+  case OP_PUSH_INT:
+  case OP_DUP:
+  case OP_LOAD_LOCAL:
+  case OP_LOAD_GLOBAL:
+  case OP_LOAD_GLOBAL_FN:
+    return 1;
+  case OP_DEFINE_LOCAL:
+  case OP_DEFINE_GLOBAL:
+  case OP_DEFINE_FUNCTION:
+  case OP_TO_BOOL:
+  case OP_JUMP:
+    return 0;
+  case OP_CALL:
+    return -a;
+  default:
+    return -1;
+  }
+}
+
+Opcode binary_opcode(int tag) {
+  switch (tag) {
+  case AST_ADD:           return OP_ADD;
+  case AST_SUB:           return OP_SUB;
+  case AST_MULTIPLY:      return OP_MULTIPLY;
+  case AST_DIVIDE:        return OP_DIVIDE;
+  case AST_LESS:          return OP_LESS;
+  case AST_LESS_EQUAL:    return OP_LESS_EQUAL;
+  case AST_GREATER:       return OP_GREATER;
+  case AST_GREATER_EQUAL: return OP_GREATER_EQUAL;
+  case AST_EQUAL:         return OP_EQUAL;
+  case AST_NOT_EQUAL:     return OP_NOT_EQUAL;
+  default:
+    RuntimeError::raise("Unknown AST node type %d during compilation.", tag);
+  }
+}
+
+Function *new_function(const std::string &name, const std::vector<Symbol> &params, Environment *env, Node *body) {
+  return new Function(name, params, env, body);
+}
+
+Function *new_function(const std::string &name, const std::vector<Symbol> &params, Environment *env, FlatNode body) {
+  return new Function(name, params, env, body);
+}
+
+}
+
+Bytecode::Bytecode()
+  : m_num_locals(0)
+  , m_max_stack(0)
+#ifdef THREADED_DISPATCH
+  , m_threaded(false)
+#endif
+{
+}
+
+#ifdef THREADED_DISPATCH
+void Bytecode::thread(const void *const handlers[]) const {
+  for (Instruction &ins : m_code) {
+    ins.handler = handlers[ins.op];
+  }
+  m_threaded = true;
+}
+#endif
+
+BytecodeCompiler::BytecodeCompiler(Environment *globals)
+  : m_globals(globals)
+  , m_out(nullptr)
+  , m_stack_depth(0) {
+}
+
+BytecodeCompiler::~BytecodeCompiler() {
+}
+
+const Bytecode *BytecodeCompiler::compile_program(Node *unit) {
+  compile_unit(unit);
+  return m_compiled.back().get();
+}
+
+const Bytecode *BytecodeCompiler::compile_program(FlatNode unit) {
+  compile_unit(unit);
+  return m_compiled.back().get();
+}
+
+const Bytecode *BytecodeCompiler::compile_function(Function *fn) {
+  if (fn->get_bytecode() == nullptr) {
+    unsigned num_params = fn->get_num_params();
+    if (fn->get_flat_body()) {
+      compile_body(fn->get_flat_body(), num_params);
+    } else {
+      compile_body(fn->get_body(), num_params);
+    }
+    fn->set_bytecode(m_compiled.back().get());
+  }
+  return fn->get_bytecode();
+}
+
+// The program is executed in the global environment, so the
+// variables it defines are global variables
+template<typename NodeRef>
+void BytecodeCompiler::compile_unit(NodeRef unit) {
+  start(new Bytecode());
+  unsigned num_kids = unit->get_num_kids();
+  if (num_kids == 0) {
+    emit(OP_PUSH_INT, unit->get_loc(), 0);
+  }
+  for (unsigned i = 0; i < num_kids; ++i) {
+    compile(unit->get_kid(i), i == num_kids - 1);
+  }
+  m_out->m_num_locals = m_scopes.get_num_locals();
+  emit(OP_RETURN, unit->get_loc());
+}
+
+// The arguments of a call are its first local variables
+template<typename NodeRef>
+void BytecodeCompiler::compile_body(NodeRef body, unsigned num_params) {
+  start(new Bytecode());
+  m_scopes.push(num_params, num_params);
+  compile(body, true);
+  m_out->m_num_locals = m_scopes.get_num_locals();
+  emit(OP_RETURN, body->get_loc());
+}
+
+void BytecodeCompiler::start(Bytecode *out) {
+  m_compiled.push_back(std::unique_ptr<Bytecode>(out));
+  m_out = out;
+  m_scopes.clear();
+  m_stack_depth = 0;
+}
+
+unsigned BytecodeCompiler::emit(Opcode op, const Location &loc, int a, int b, Symbol name) {
+  unsigned pc = unsigned(m_out->m_code.size());
+  m_out->m_code.push_back({ op, a, b });
+  m_out->m_locs.push_back(loc);
+  m_out->m_names.push_back(name);
+  m_stack_depth += stack_effect(op, a);
+  m_out->m_max_stack = std::max(m_out->m_max_stack, m_stack_depth);
+  return pc;
+}
+
+// Emit a jump whose target is filled in later by set_jump_target()
+unsigned BytecodeCompiler::emit_jump(Opcode op, const Location &loc) {
+  return emit(op, loc, -1);
+}
+
+// Make a jump emitted by emit_jump() jump to the next instruction
+void BytecodeCompiler::set_jump_target(unsigned pc) {
+  m_out->m_code[pc].a = int(m_out->m_code.size());
+}
+
+// Variables in scopes enclosing the call's outermost scope are global
+void BytecodeCompiler::emit_load(unsigned depth, unsigned slot, const Location &loc, Symbol name, bool function) {
+  if (m_scopes.is_local(depth)) {
+    emit(OP_LOAD_LOCAL, loc, int(m_scopes.get_local(depth, slot)), 0, name);
+  } else {
+    emit(function ? OP_LOAD_GLOBAL_FN : OP_LOAD_GLOBAL, loc, int(m_scopes.get_global_depth(depth)), int(slot), name);
+  }
+}
+
+void BytecodeCompiler::emit_store(unsigned depth, unsigned slot, const Location &loc, Symbol name) {
+  if (m_scopes.is_local(depth)) {
+    emit(OP_STORE_LOCAL, loc, int(m_scopes.get_local(depth, slot)), 0, name);
+  } else {
+    emit(OP_STORE_GLOBAL, loc, int(m_scopes.get_global_depth(depth)), int(slot), name);
+  }
+}
+
+// Compile the statements of a block, which (like Interpreter::evaluate())
+// only gets a scope of its own if it defines variables
+template<typename NodeRef>
+void BytecodeCompiler::compile_statements(NodeRef node, bool keep_value) {
+  unsigned num_vars = node->get_num_vars();
+  if (num_vars > 0) {
+    m_scopes.push(num_vars);
+  }
+  unsigned num_kids = node->get_num_kids();
+  if (num_kids == 0 && keep_value) {
+    emit(OP_PUSH_INT, node->get_loc(), 0);
+  }
+  for (unsigned i = 0; i < num_kids; ++i) {
+    compile(node->get_kid(i), keep_value && i == num_kids - 1);
+  }
+  if (num_vars > 0) {
+    m_scopes.pop();
+  }
+}
+
+// Compile code which evaluates a node, leaving its value on the stack
+// if keep_value is true.  The code does the same things, in the same
+// order, as Interpreter::evaluate(), so errors are reported in the
+// same way.
+template<typename NodeRef>
+void BytecodeCompiler::compile(NodeRef node, bool keep_value) {
+  const Location &loc = node->get_loc();
+
+  switch (node->get_tag()) {
+    case AST_INT_LITERAL:
+      if (keep_value) {
+        emit(OP_PUSH_INT, loc, node->get_int_value());
+      }
+      return;
+    case AST_VARREF:
+      emit_load(node->get_depth(), node->get_slot(), loc, node->get_symbol(), false);
+      break;
+    case AST_VARDEF: {
+      Symbol var_name = node->get_kid(0)->get_symbol();
+      if (m_scopes.empty()) {
+        emit(OP_DEFINE_GLOBAL, loc, int(var_name), 0, var_name);
+      } else {
+        emit(OP_DEFINE_LOCAL, loc, int(m_scopes.define()), 0, var_name);
+      }
+      if (keep_value) {
+        emit(OP_PUSH_INT, loc, 0);
+      }
+      return;
+    }
+    case AST_ASSIGN: {
+      NodeRef var_ref_node = node->get_kid(0);
+      compile(node->get_kid(1), true);
+      if (keep_value) {
+        emit(OP_DUP, loc);
+      }
+      emit_store(var_ref_node->get_depth(), var_ref_node->get_slot(), loc, var_ref_node->get_symbol());
+      return;
+    }
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MULTIPLY:
+    case AST_DIVIDE:
+    case AST_LESS:
+    case AST_LESS_EQUAL:
+    case AST_GREATER:
+    case AST_GREATER_EQUAL:
+    case AST_EQUAL:
+    case AST_NOT_EQUAL:
+      compile(node->get_kid(0), true);
+      compile(node->get_kid(1), true);
+      emit(binary_opcode(node->get_tag()), loc);
+      break;
+    case AST_LOGICAL_AND:
+    case AST_LOGICAL_OR: {
+      compile(node->get_kid(0), true);
+      unsigned jump = emit_jump(node->get_tag() == AST_LOGICAL_AND ? OP_AND : OP_OR, loc);
+      compile(node->get_kid(1), true);
+      emit(OP_TO_BOOL, loc);
+      set_jump_target(jump);
+      break;
+    }
+    case AST_STATEMENT:
+      compile(node->get_kid(0), keep_value);
+      return;
+    case AST_FNCALL: {
+      NodeRef func_varref_node = node->get_kid(0);
+      emit_load(func_varref_node->get_depth(), func_varref_node->get_slot(), loc, func_varref_node->get_symbol(), true);
+      unsigned num_args = 0;
+      if (node->get_num_kids() > 1) {
+        NodeRef arg_list_node = node->get_kid(1);
+        num_args = arg_list_node->get_num_kids();
+        for (unsigned i = 0; i < num_args; ++i) {
+          compile(arg_list_node->get_kid(i), true);
+        }
+      }
+      emit(OP_CALL, loc, int(num_args), 0, func_varref_node->get_symbol());
+      break;
+    }
+    case AST_FUNCTION:
+      compile_function_def(node);
+      if (keep_value) {
+        emit(OP_PUSH_INT, loc, 0);
+      }
+      return;
+    case AST_IF: {
+      compile(node->get_kid(0), true);
+      unsigned jump_to_else = emit_jump(OP_JUMP_IF_FALSE, loc);
+      compile_statements(node->get_kid(1), false);
+      if (node->get_num_kids() > 2) {
+        unsigned jump_to_end = emit_jump(OP_JUMP, loc);
+        set_jump_target(jump_to_else);
+        compile_statements(node->get_kid(2), false);
+        set_jump_target(jump_to_end);
+      } else {
+        set_jump_target(jump_to_else);
+      }
+      if (keep_value) {
+        emit(OP_PUSH_INT, loc, 0);
+      }
+      return;
+    }
+    case AST_WHILE: {
+      unsigned top = m_out->get_size();
+      compile(node->get_kid(0), true);
+      unsigned jump_to_end = emit_jump(OP_JUMP_IF_FALSE, loc);
+      compile_statements(node->get_kid(1), false);
+      emit(OP_JUMP, loc, int(top));
+      set_jump_target(jump_to_end);
+      if (keep_value) {
+        emit(OP_PUSH_INT, loc, 0);
+      }
+      return;
+    }
+    case AST_STATEMENT_LIST:
+      compile_statements(node, keep_value);
+      return;
+    default:
+      RuntimeError::raise("Unknown AST node type %d during compilation.", node->get_tag());
+  }
+
+  if (!keep_value) {
+    emit(OP_POP, loc);
+  }
+}
+
+// Functions can only be defined at the top level of the program,
+// so the Function (whose parent environment is the global
+// environment) can be created now, and defined when the
+// definition is executed.
+template<typename NodeRef>
+void BytecodeCompiler::compile_function_def(NodeRef node) {
+  assert(m_scopes.empty());
+  NodeRef func_name_node = node->get_kid(0);
+  std::vector<Symbol> params;
+  if (node->get_num_kids() > 2) {
+    NodeRef param_list = node->get_kid(1);
+    for (unsigned i = 0; i < param_list->get_num_kids(); ++i) {
+      params.push_back(param_list->get_kid(i)->get_symbol());
+    }
+  }
+  Function *fn = new_function(std::string(func_name_node->get_str()), params, m_globals, node->get_last_kid());
+  m_functions.push_back(Value(fn));
+  emit(OP_DEFINE_FUNCTION, node->get_loc(), int(m_functions.size() - 1), 0, func_name_node->get_symbol());
+}
@@ -0,0 +1,154 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <memory>
+#include <vector>
+#include "symtab.h"
+#include "location.h"
+#include "value.h"
+#include "flat_ast.h"
+#include "dispatch.h"
+#include "local_scopes.h"
+class Node;
+class Environment;
+class Function;
+
+// Instructions for the stack-based virtual machine (see VM).  Operands
+// are popped from, and results pushed onto, the current call's operand
+// stack.  A call's local variables (its parameters, followed by the
+// variables defined in its blocks) are numbered from 0, and global
+// variables are addressed as in the global Environment.
+enum Opcode {
+  OP_PUSH_INT,        // push the int a
+  OP_POP,             // discard the top of the stack
+  OP_DUP,             // push a copy of the top of the stack
+  OP_LOAD_LOCAL,      // push local variable a
+  OP_STORE_LOCAL,     // pop into local variable a
+  OP_DEFINE_LOCAL,    // define local variable a (setting it to 0)
+  OP_LOAD_GLOBAL,     // push the global variable with lexical address (a, b)
+  OP_LOAD_GLOBAL_FN,  // the same, for the function being called
+  OP_STORE_GLOBAL,    // pop into the global variable with lexical address (a, b)
+  OP_DEFINE_GLOBAL,   // define the global variable named by the Symbol a
+  OP_DEFINE_FUNCTION, // define the global variable for function a of the program
+  OP_ADD,             // pop two ints, and push the result
+  OP_SUB,
+  OP_MULTIPLY,
+  OP_DIVIDE,
+  OP_LESS,            // pop two ints, and push 1 if the comparison is true, 0 if not
+  OP_LESS_EQUAL,
+  OP_GREATER,
+  OP_GREATER_EQUAL,
+  OP_EQUAL,
+  OP_NOT_EQUAL,
+  OP_AND,             // pop an int: if it is 0, push 0 and jump to a
+  OP_OR,              // pop an int: if it isn't 0, push 1 and jump to a
+  OP_TO_BOOL,         // pop an int, and push 1 if it isn't 0, 0 if it is
+  OP_JUMP,            // jump to a
+  OP_JUMP_IF_FALSE,   // pop an int, and jump to a if it is 0
+  OP_CALL,            // call the function below the a arguments on the stack
+  OP_RETURN,          // return the top of the stack from the current call
+  OP_NUM_OPCODES
+};
+
+struct Instruction {
+  Opcode op;
+  int a, b;
+#ifdef THREADED_DISPATCH
+  const void *handler;  // the address of the VM's handler for op
+#endif
+};
+
+// The compiled code of a function body, or of the program itself.
+// The information only needed to report errors (the source location
+// and variable name of each instruction) is kept apart from the
+// instructions.
+class Bytecode {
+private:
+  friend class BytecodeCompiler;
+
+  mutable std::vector<Instruction> m_code;  // (mutable so it can be threaded)
+  std::vector<Location> m_locs;
+  std::vector<Symbol> m_names;
+  unsigned m_num_locals;  // number of local variables
+  unsigned m_max_stack;   // maximum depth of the operand stack
+#ifdef THREADED_DISPATCH
+  mutable bool m_threaded;
+#endif
+
+  // value semantics prohibited
+  Bytecode(const Bytecode &);
+  Bytecode &operator=(const Bytecode &);
+
+public:
+  Bytecode();
+
+  const Instruction *get_code() const { return m_code.data(); }
+  unsigned get_size() const { return unsigned(m_code.size()); }
+  const Location &get_loc(unsigned pc) const { return m_locs[pc]; }
+  Symbol get_name(unsigned pc) const { return m_names[pc]; }
+  unsigned get_num_locals() const { return m_num_locals; }
+  unsigned get_max_stack() const { return m_max_stack; }
+
+#ifdef THREADED_DISPATCH
+  // Set the handler of each instruction, from a table of the handlers
+  // for each opcode.
+  bool is_threaded() const { return m_threaded; }
+  void thread(const void *const handlers[]) const;
+#endif
+};
+
+// Compiles an analyzed AST (see Interpreter::analyze()) to Bytecode.
+// The program is compiled when compile_program() is called, and
+// each function is compiled when it is first called, so that
+// functions whose bodies are parsed lazily can be compiled.
+class BytecodeCompiler {
+private:
+  Environment *m_globals;
+  std::vector<std::unique_ptr<Bytecode>> m_compiled;
+  std::vector<Value> m_functions;  // the program's functions
+
+  // state while compiling one Bytecode
+  Bytecode *m_out;
+  LocalScopes m_scopes;           // scopes enclosed by the global scope
+  unsigned m_stack_depth;
+
+  // value semantics prohibited
+  BytecodeCompiler(const BytecodeCompiler &);
+  BytecodeCompiler &operator=(const BytecodeCompiler &);
+
+public:
+  // Functions defined by the program are defined in the given
+  // global environment, which is where the program is executed.
+  BytecodeCompiler(Environment *globals);
+  ~BytecodeCompiler();
+
+  const Bytecode *compile_program(Node *unit);
+  const Bytecode *compile_program(FlatNode unit);
+
+  // Compile the body of a function, which must have been analyzed.
+  const Bytecode *compile_function(Function *fn);
+
+  // Get the Function value for function a of OP_DEFINE_FUNCTION.
+  const Value &get_function(unsigned index) const { return m_functions[index]; }
+
+private:
+  template<typename NodeRef>
+  void compile_unit(NodeRef unit);
+  template<typename NodeRef>
+  void compile_body(NodeRef body, unsigned num_params);
+  template<typename NodeRef>
+  void compile_statements(NodeRef node, bool keep_value);
+  template<typename NodeRef>
+  void compile(NodeRef node, bool keep_value);
+  template<typename NodeRef>
+  void compile_function_def(NodeRef node);
+
+  void start(Bytecode *out);
+  unsigned emit(Opcode op, const Location &loc, int a = 0, int b = 0, Symbol name = NO_SYMBOL);
+  unsigned emit_jump(Opcode op, const Location &loc);
+  void set_jump_target(unsigned pc);
+  void emit_load(unsigned depth, unsigned slot, const Location &loc, Symbol name, bool function);
+  void emit_store(unsigned depth, unsigned slot, const Location &loc, Symbol name);
+};
+
+#endif // BYTECODE_H
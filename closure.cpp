@@ -0,0 +1,588 @@
+#include <cassert>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include "ast.h"
+#include "node.h"
+#include "exceptions.h"
+#include "environment.h"
+#include "function.h"
+#include "interp.h"
+#include "binary_op.h"
+#include "closure.h"
+
+namespace {
+
+// The kinds of ExecNode.  They are allocated in the compiler's arena,
+// so they must be trivially destructible.
+
+struct IntNode : ExecNode {
+  int value;
+};
+
+struct LocalNode : ExecNode {
+  unsigned index;  // local variable number
+};
+
+struct GlobalNode : ExecNode {
+  Environment *globals;
+  unsigned depth, slot;  // lexical address in the global environment
+  Symbol name;
+};
+
+struct DefineGlobalNode : ExecNode {
+  Environment *globals;
+  Symbol name;
+};
+
+struct AssignLocalNode : ExecNode {
+  const ExecNode *value;
+  unsigned index;
+};
+
+struct AssignGlobalNode : ExecNode {
+  const ExecNode *value;
+  Environment *globals;
+  unsigned depth, slot;
+  Symbol name;
+};
+
+struct BinaryNode : ExecNode {
+  const ExecNode *left, *right;
+};
+
+struct SequenceNode : ExecNode {
+  const ExecNode **kids;
+  unsigned num_kids;
+};
+
+struct IfNode : ExecNode {
+  const ExecNode *condition, *true_branch, *false_branch;  // false_branch may be null
+};
+
+struct WhileNode : ExecNode {
+  const ExecNode *condition, *body;
+};
+
+struct CallNode : ExecNode {
+  const ExecNode *callee;
+  const ExecNode **args;
+  unsigned num_args;
+  Symbol name;
+  ClosureCompiler *compiler;
+  Interpreter *interp;
+};
+
+struct DefineFunctionNode : ExecNode {
+  Environment *globals;
+  Function *function;  // (a reference is held by the compiler)
+  Symbol name;
+};
+
+// A call whose function has at most this many local variables keeps
+// them on the native stack
+const unsigned SMALL_FRAME_SIZE = 8;
+
+// The functions which execute each kind of node.  They do the same
+// things, in the same order, as Interpreter::evaluate(), so errors are
+// reported in the same way.
+
+Value exec_int(const ExecNode *node, Value *) {
+  return Value(static_cast<const IntNode *>(node)->value);
+}
+
+Value exec_local(const ExecNode *node, Value *locals) {
+  return locals[static_cast<const LocalNode *>(node)->index];
+}
+
+Value exec_global(const ExecNode *node, Value *) {
+  const GlobalNode *n = static_cast<const GlobalNode *>(node);
+  Value *var = n->globals->get_slot(n->depth, n->slot);
+  if (var == nullptr) {
+    RuntimeError::raise("Undefined variable '%s' during execution.", SymbolTable::get_name(n->name).c_str());
+  }
+  return *var;
+}
+
+// the function being called
+Value exec_global_fn(const ExecNode *node, Value *) {
+  const GlobalNode *n = static_cast<const GlobalNode *>(node);
+  Value *var = n->globals->get_slot(n->depth, n->slot);
+  if (var == nullptr) {
+    RuntimeError::raise("Undefined variable: '%s'", SymbolTable::get_name(n->name).c_str());
+  }
+  return *var;
+}
+
+Value exec_define_local(const ExecNode *node, Value *locals) {
+  locals[static_cast<const LocalNode *>(node)->index] = Value(0);
+  return Value(0);
+}
+
+Value exec_define_global(const ExecNode *node, Value *) {
+  const DefineGlobalNode *n = static_cast<const DefineGlobalNode *>(node);
+  if (!n->globals->define_variable(n->name, Value(0))) {
+    EvaluationError::raise(node->loc, "Variable '%s' already defined in this scope.", SymbolTable::get_name(n->name).c_str());
+  }
+  return Value(0);
+}
+
+Value exec_assign_local(const ExecNode *node, Value *locals) {
+  const AssignLocalNode *n = static_cast<const AssignLocalNode *>(node);
+  Value val = n->value->exec(locals);
+  locals[n->index] = val;
+  return val;
+}
+
+Value exec_assign_global(const ExecNode *node, Value *locals) {
+  const AssignGlobalNode *n = static_cast<const AssignGlobalNode *>(node);
+  Value val = n->value->exec(locals);
+  Value *var = n->globals->get_slot(n->depth, n->slot);
+  if (var == nullptr) {
+    SemanticError::raise(node->loc, "Assignment to undefined variable '%s'.", SymbolTable::get_name(n->name).c_str());
+  }
+  *var = val;
+  return val;
+}
+
+// How the operands of a binary operator are evaluated: operands which
+// are local variables or constants are used directly, rather than
+// through their nodes' functions
+struct AnyOperand {
+  static Value get(const ExecNode *node, Value *locals) { return node->exec(locals); }
+};
+struct LocalOperand {
+  static Value get(const ExecNode *node, Value *locals) { return exec_local(node, locals); }
+};
+struct IntOperand {
+  static Value get(const ExecNode *node, Value *locals) { return exec_int(node, locals); }
+};
+
+template<typename Op, typename Left, typename Right>
+Value exec_binary(const ExecNode *node, Value *locals) {
+  const BinaryNode *n = static_cast<const BinaryNode *>(node);
+  Value left_val = Left::get(n->left, locals);
+  Value right_val = Right::get(n->right, locals);
+  return apply_binary_op<Op>(left_val, right_val, node->loc);
+}
+
+template<typename Op, typename Left>
+ExecFn binary_fn(const ExecNode *right) {
+  if (right->fn == exec_local) {
+    return exec_binary<Op, Left, LocalOperand>;
+  } else if (right->fn == exec_int) {
+    return exec_binary<Op, Left, IntOperand>;
+  }
+  return exec_binary<Op, Left, AnyOperand>;
+}
+
+template<typename Op>
+ExecFn binary_fn(const ExecNode *left, const ExecNode *right) {
+  if (left->fn == exec_local) {
+    return binary_fn<Op, LocalOperand>(right);
+  } else if (left->fn == exec_int) {
+    return binary_fn<Op, IntOperand>(right);
+  }
+  return binary_fn<Op, AnyOperand>(right);
+}
+
+// Select the function for a binary operator node, given its compiled
+// operands
+ExecFn binary_fn(int tag, const ExecNode *left, const ExecNode *right) {
+  switch (tag) {
+#define BINARY_FN_CASE(op) \
+  case AST_##op: return binary_fn<BinaryOp<AST_##op>>(left, right);
+  AST_BINARY_OPERATORS(BINARY_FN_CASE)
+#undef BINARY_FN_CASE
+  default:
+    RuntimeError::raise("Unknown AST node type %d during compilation.", tag);
+  }
+}
+
+// Evaluate an operand of && or ||, which must be an int
+bool exec_truth(const ExecNode *operand, const ExecNode *node, Value *locals) {
+  Value val = operand->exec(locals);
+  if (!val.is_int()) {
+    EvaluationError::raise(node->loc, "Operand must be an integer.");
+  }
+  return val.get_ival() != 0;
+}
+
+Value exec_and(const ExecNode *node, Value *locals) {
+  const BinaryNode *n = static_cast<const BinaryNode *>(node);
+  if (!exec_truth(n->left, node, locals)) {
+    return Value(0); // Short-circuit
+  }
+  return Value(exec_truth(n->right, node, locals) ? 1 : 0);
+}
+
+Value exec_or(const ExecNode *node, Value *locals) {
+  const BinaryNode *n = static_cast<const BinaryNode *>(node);
+  if (exec_truth(n->left, node, locals)) {
+    return Value(1); // Short-circuit
+  }
+  return Value(exec_truth(n->right, node, locals) ? 1 : 0);
+}
+
+Value exec_sequence(const ExecNode *node, Value *locals) {
+  const SequenceNode *n = static_cast<const SequenceNode *>(node);
+  Value last_val(0);
+  for (unsigned i = 0; i < n->num_kids; ++i) {
+    last_val = n->kids[i]->exec(locals);
+  }
+  return last_val;
+}
+
+// Evaluate the condition of an if or while statement
+bool exec_condition(const ExecNode *condition, const ExecNode *node, Value *locals) {
+  Value condition_val = condition->exec(locals);
+  if (!condition_val.is_int()) {
+    EvaluationError::raise(node->loc, "Condition must evaluate to an integer");
+  }
+  return condition_val.get_ival() != 0;
+}
+
+Value exec_if(const ExecNode *node, Value *locals) {
+  const IfNode *n = static_cast<const IfNode *>(node);
+  if (exec_condition(n->condition, node, locals)) {
+    n->true_branch->exec(locals);
+  } else if (n->false_branch != nullptr) {
+    n->false_branch->exec(locals);
+  }
+  return Value(0); // Control flow statements evaluate to 0
+}
+
+Value exec_while(const ExecNode *node, Value *locals) {
+  const WhileNode *n = static_cast<const WhileNode *>(node);
+  while (exec_condition(n->condition, node, locals)) {
+    n->body->exec(locals);
+  }
+  return Value(0); // Control flow statements evaluate to 0
+}
+
+// The arguments of a call become the first local variables of the
+// function called
+Value exec_call(const ExecNode *node, Value *locals) {
+  const CallNode *n = static_cast<const CallNode *>(node);
+  Value fn_val = n->callee->exec(locals);
+
+  Value small_frame[SMALL_FRAME_SIZE];
+  std::vector<Value> large_frame;
+  Value *frame = small_frame;
+  if (n->num_args > SMALL_FRAME_SIZE) {
+    large_frame.resize(n->num_args);
+    frame = large_frame.data();
+  }
+  for (unsigned i = 0; i < n->num_args; ++i) {
+    frame[i] = n->args[i]->exec(locals);
+  }
+
+  if (fn_val.is_intrinsic_fn()) {
+    return fn_val.get_intrinsic_fn()(frame, n->num_args, node->loc, n->interp);
+  }
+  const ClosureCode *code = n->compiler->compile_function(n->interp->check_call(fn_val, n->num_args, node->loc, n->name));
+  unsigned num_locals = code->get_num_locals();
+  if (num_locals > SMALL_FRAME_SIZE && num_locals > large_frame.size()) {
+    std::vector<Value> new_frame(frame, frame + n->num_args);
+    new_frame.resize(num_locals);
+    large_frame.swap(new_frame);
+    frame = large_frame.data();
+  }
+  n->compiler->enter_call();
+  Value result = code->execute(frame);
+  n->compiler->leave_call();
+  return result;
+}
+
+Value exec_define_function(const ExecNode *node, Value *) {
+  const DefineFunctionNode *n = static_cast<const DefineFunctionNode *>(node);
+  if (!n->globals->define_variable(n->name, Value(n->function))) {
+    EvaluationError::raise(node->loc, "Variable '%s' already defined in this scope.", SymbolTable::get_name(n->name).c_str());
+  }
+  return Value(0); // Function definitions evaluate to 0
+}
+
+Function *new_function(const std::string &name, const std::vector<Symbol> &params, Environment *env, Node *body) {
+  return new Function(name, params, env, body);
+}
+
+Function *new_function(const std::string &name, const std::vector<Symbol> &params, Environment *env, FlatNode body) {
+  return new Function(name, params, env, body);
+}
+
+}
+
+ClosureCode::ClosureCode()
+  : m_root(nullptr)
+  , m_num_locals(0) {
+}
+
+ClosureCompiler::ClosureCompiler(Interpreter *interp, Environment *globals)
+  : m_interp(interp)
+  , m_globals(globals)
+  , m_call_depth(0)
+  , m_out(nullptr) {
+}
+
+ClosureCompiler::~ClosureCompiler() {
+}
+
+const ClosureCode *ClosureCompiler::compile_program(Node *unit) {
+  compile_unit(unit);
+  return m_compiled.back().get();
+}
+
+const ClosureCode *ClosureCompiler::compile_program(FlatNode unit) {
+  compile_unit(unit);
+  return m_compiled.back().get();
+}
+
+const ClosureCode *ClosureCompiler::compile_function(Function *fn) {
+  if (fn->get_closure_code() == nullptr) {
+    unsigned num_params = fn->get_num_params();
+    if (fn->get_flat_body()) {
+      compile_body(fn->get_flat_body(), num_params);
+    } else {
+      compile_body(fn->get_body(), num_params);
+    }
+    fn->set_closure_code(m_compiled.back().get());
+  }
+  return fn->get_closure_code();
+}
+
+void ClosureCompiler::enter_call() {
+  Interpreter::check_call_depth(m_call_depth);
+  m_call_depth++;
+}
+
+// The program is executed in the global environment, so the
+// variables it defines are global variables
+template<typename NodeRef>
+void ClosureCompiler::compile_unit(NodeRef unit) {
+  start(new ClosureCode());
+  unsigned num_kids = unit->get_num_kids();
+  SequenceNode *seq = new_node<SequenceNode>(exec_sequence, unit->get_loc());
+  seq->kids = new_kids(num_kids);
+  seq->num_kids = num_kids;
+  for (unsigned i = 0; i < num_kids; ++i) {
+    seq->kids[i] = compile(unit->get_kid(i));
+  }
+  m_out->m_root = seq;
+  m_out->m_num_locals = m_scopes.get_num_locals();
+}
+
+// The arguments of a call are its first local variables
+template<typename NodeRef>
+void ClosureCompiler::compile_body(NodeRef body, unsigned num_params) {
+  start(new ClosureCode());
+  m_scopes.push(num_params, num_params);
+  m_out->m_root = compile(body);
+  m_out->m_num_locals = m_scopes.get_num_locals();
+}
+
+void ClosureCompiler::start(ClosureCode *out) {
+  m_compiled.push_back(std::unique_ptr<ClosureCode>(out));
+  m_out = out;
+  m_scopes.clear();
+}
+
+template<typename T>
+T *ClosureCompiler::new_node(ExecFn fn, const Location &loc) {
+  static_assert(std::is_trivially_destructible<T>::value, "ExecNodes are freed without being destroyed");
+  T *node = ::new (m_arena.allocate(sizeof(T), alignof(T))) T();
+  node->fn = fn;
+  node->loc = loc;
+  return node;
+}
+
+const ExecNode **ClosureCompiler::new_kids(unsigned num_kids) {
+  return static_cast<const ExecNode **>(m_arena.allocate(num_kids * sizeof(const ExecNode *), alignof(const ExecNode *)));
+}
+
+const ExecNode *ClosureCompiler::new_int(int value, const Location &loc) {
+  IntNode *node = new_node<IntNode>(exec_int, loc);
+  node->value = value;
+  return node;
+}
+
+// Variables in scopes enclosing the call's outermost scope are global
+const ExecNode *ClosureCompiler::new_load(unsigned depth, unsigned slot, const Location &loc, Symbol name, bool function) {
+  if (m_scopes.is_local(depth)) {
+    LocalNode *node = new_node<LocalNode>(exec_local, loc);
+    node->index = m_scopes.get_local(depth, slot);
+    return node;
+  }
+  GlobalNode *node = new_node<GlobalNode>(function ? exec_global_fn : exec_global, loc);
+  node->globals = m_globals;
+  node->depth = m_scopes.get_global_depth(depth);
+  node->slot = slot;
+  node->name = name;
+  return node;
+}
+
+// Compile the statements of a block, which (like Interpreter::evaluate())
+// only gets a scope of its own if it defines variables.  A block of one
+// statement is compiled to that statement.
+template<typename NodeRef>
+const ExecNode *ClosureCompiler::compile_statements(NodeRef node) {
+  unsigned num_vars = node->get_num_vars();
+  if (num_vars > 0) {
+    m_scopes.push(num_vars);
+  }
+  unsigned num_kids = node->get_num_kids();
+  const ExecNode *result;
+  if (num_kids == 1) {
+    result = compile(node->get_kid(0));
+  } else {
+    SequenceNode *seq = new_node<SequenceNode>(exec_sequence, node->get_loc());
+    seq->kids = new_kids(num_kids);
+    seq->num_kids = num_kids;
+    for (unsigned i = 0; i < num_kids; ++i) {
+      seq->kids[i] = compile(node->get_kid(i));
+    }
+    result = seq;
+  }
+  if (num_vars > 0) {
+    m_scopes.pop();
+  }
+  return result;
+}
+
+template<typename NodeRef>
+const ExecNode *ClosureCompiler::compile(NodeRef node) {
+  const Location &loc = node->get_loc();
+
+  switch (node->get_tag()) {
+    case AST_INT_LITERAL:
+      return new_int(node->get_int_value(), loc);
+    case AST_VARREF:
+      return new_load(node->get_depth(), node->get_slot(), loc, node->get_symbol(), false);
+    case AST_VARDEF: {
+      Symbol var_name = node->get_kid(0)->get_symbol();
+      if (m_scopes.empty()) {
+        DefineGlobalNode *def = new_node<DefineGlobalNode>(exec_define_global, loc);
+        def->globals = m_globals;
+        def->name = var_name;
+        return def;
+      }
+      LocalNode *def = new_node<LocalNode>(exec_define_local, loc);
+      def->index = m_scopes.define();
+      return def;
+    }
+    case AST_ASSIGN: {
+      NodeRef var_ref_node = node->get_kid(0);
+      const ExecNode *value = compile(node->get_kid(1));
+      unsigned depth = var_ref_node->get_depth(), slot = var_ref_node->get_slot();
+      if (m_scopes.is_local(depth)) {
+        AssignLocalNode *assign = new_node<AssignLocalNode>(exec_assign_local, loc);
+        assign->value = value;
+        assign->index = m_scopes.get_local(depth, slot);
+        return assign;
+      }
+      AssignGlobalNode *assign = new_node<AssignGlobalNode>(exec_assign_global, loc);
+      assign->value = value;
+      assign->globals = m_globals;
+      assign->depth = m_scopes.get_global_depth(depth);
+      assign->slot = slot;
+      assign->name = var_ref_node->get_symbol();
+      return assign;
+    }
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MULTIPLY:
+    case AST_DIVIDE:
+    case AST_LESS:
+    case AST_LESS_EQUAL:
+    case AST_GREATER:
+    case AST_GREATER_EQUAL:
+    case AST_EQUAL:
+    case AST_NOT_EQUAL:
+      return compile_binary(node);
+    case AST_LOGICAL_AND:
+    case AST_LOGICAL_OR: {
+      BinaryNode *logical = new_node<BinaryNode>(node->get_tag() == AST_LOGICAL_AND ? exec_and : exec_or, loc);
+      logical->left = compile(node->get_kid(0));
+      logical->right = compile(node->get_kid(1));
+      return logical;
+    }
+    case AST_STATEMENT:
+      return compile(node->get_kid(0));
+    case AST_FNCALL:
+      return compile_call(node);
+    case AST_FUNCTION:
+      return compile_function_def(node);
+    case AST_IF: {
+      IfNode *if_node = new_node<IfNode>(exec_if, loc);
+      if_node->condition = compile(node->get_kid(0));
+      if_node->true_branch = compile_statements(node->get_kid(1));
+      if_node->false_branch = node->get_num_kids() > 2 ? compile_statements(node->get_kid(2)) : nullptr;
+      return if_node;
+    }
+    case AST_WHILE: {
+      WhileNode *while_node = new_node<WhileNode>(exec_while, loc);
+      while_node->condition = compile(node->get_kid(0));
+      while_node->body = compile_statements(node->get_kid(1));
+      return while_node;
+    }
+    case AST_STATEMENT_LIST:
+      return compile_statements(node);
+    default:
+      RuntimeError::raise("Unknown AST node type %d during compilation.", node->get_tag());
+  }
+}
+
+// The function executing a binary operator node is specialized for
+// the operator, and for operands which are local variables or constants
+template<typename NodeRef>
+const ExecNode *ClosureCompiler::compile_binary(NodeRef node) {
+  const ExecNode *left = compile(node->get_kid(0));
+  const ExecNode *right = compile(node->get_kid(1));
+  BinaryNode *binary = new_node<BinaryNode>(binary_fn(node->get_tag(), left, right), node->get_loc());
+  binary->left = left;
+  binary->right = right;
+  return binary;
+}
+
+template<typename NodeRef>
+const ExecNode *ClosureCompiler::compile_call(NodeRef node) {
+  NodeRef func_varref_node = node->get_kid(0);
+  CallNode *call = new_node<CallNode>(exec_call, node->get_loc());
+  call->callee = new_load(func_varref_node->get_depth(), func_varref_node->get_slot(), node->get_loc(), func_varref_node->get_symbol(), true);
+  call->num_args = 0;
+  if (node->get_num_kids() > 1) {
+    NodeRef arg_list_node = node->get_kid(1);
+    call->num_args = arg_list_node->get_num_kids();
+    call->args = new_kids(call->num_args);
+    for (unsigned i = 0; i < call->num_args; ++i) {
+      call->args[i] = compile(arg_list_node->get_kid(i));
+    }
+  }
+  call->name = func_varref_node->get_symbol();
+  call->compiler = this;
+  call->interp = m_interp;
+  return call;
+}
+
+// Functions can only be defined at the top level of the program,
+// so the Function (whose parent environment is the global
+// environment) can be created now, and defined when the
+// definition is executed.
+template<typename NodeRef>
+const ExecNode *ClosureCompiler::compile_function_def(NodeRef node) {
+  assert(m_scopes.empty());
+  NodeRef func_name_node = node->get_kid(0);
+  std::vector<Symbol> params;
+  if (node->get_num_kids() > 2) {
+    NodeRef param_list = node->get_kid(1);
+    for (unsigned i = 0; i < param_list->get_num_kids(); ++i) {
+      params.push_back(param_list->get_kid(i)->get_symbol());
+    }
+  }
+  Function *fn = new_function(std::string(func_name_node->get_str()), params, m_globals, node->get_last_kid());
+  m_functions.push_back(Value(fn));
+  DefineFunctionNode *def = new_node<DefineFunctionNode>(exec_define_function, node->get_loc());
+  def->globals = m_globals;
+  def->function = fn;
+  def->name = func_name_node->get_symbol();
+  return def;
+}
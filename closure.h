@@ -0,0 +1,126 @@
+#ifndef CLOSURE_H
+#define CLOSURE_H
+
+#include <memory>
+#include <vector>
+#include "symtab.h"
+#include "location.h"
+#include "value.h"
+#include "flat_ast.h"
+#include "ast_arena.h"
+#include "local_scopes.h"
+class Node;
+class Environment;
+class Function;
+class Interpreter;
+struct ExecNode;
+
+// The function which executes an ExecNode (chosen for the node when it
+// is compiled), given the local variables of the call in progress.
+typedef Value (*ExecFn)(const ExecNode *node, Value *locals);
+
+// A node of a closure-compiled tree.  Each kind of node (see
+// closure.cpp) extends ExecNode with what it needs to execute: its
+// children, the address of the variable it uses, its constant, and so
+// on, all resolved when the node is compiled.  As in Bytecode, a
+// call's local variables (its parameters, followed by the variables
+// defined in its blocks) are numbered from 0, and global variables
+// are addressed as in the global Environment.
+struct ExecNode {
+  ExecFn fn;
+  Location loc;
+
+  Value exec(Value *locals) const { return fn(this, locals); }
+};
+
+// The compiled body of a function, or of the program itself.
+class ClosureCode {
+private:
+  friend class ClosureCompiler;
+
+  const ExecNode *m_root;
+  unsigned m_num_locals;  // number of local variables
+
+  // value semantics prohibited
+  ClosureCode(const ClosureCode &);
+  ClosureCode &operator=(const ClosureCode &);
+
+public:
+  ClosureCode();
+
+  unsigned get_num_locals() const { return m_num_locals; }
+
+  // Execute the code, given its local variables (which must have
+  // room for get_num_locals() Values, starting with the arguments).
+  Value execute(Value *locals) const { return m_root->exec(locals); }
+};
+
+// Compiles an analyzed AST (see Interpreter::analyze()) to a tree of
+// ExecNodes, which execute themselves.  This avoids the work that
+// Interpreter::evaluate() repeats for each node it evaluates (the
+// switch on the node's tag, getting its children, and finding its
+// variables), without the cost of compiling to instructions for a
+// virtual machine.  As with BytecodeCompiler, the program is compiled
+// when compile_program() is called, and each function is compiled
+// when it is first called.
+class ClosureCompiler {
+private:
+  Interpreter *m_interp;
+  Environment *m_globals;
+  ASTArena m_arena;  // holds the ExecNodes
+  std::vector<std::unique_ptr<ClosureCode>> m_compiled;
+  std::vector<Value> m_functions;  // the program's functions
+  unsigned m_call_depth;           // calls in progress
+
+  // state while compiling one ClosureCode
+  ClosureCode *m_out;
+  LocalScopes m_scopes;  // scopes enclosed by the global scope
+
+  // value semantics prohibited
+  ClosureCompiler(const ClosureCompiler &);
+  ClosureCompiler &operator=(const ClosureCompiler &);
+
+public:
+  // Lazily-parsed function bodies are analyzed by the interpreter
+  // when they're first called.  Functions defined by the program are
+  // defined in the given global environment, which is where the
+  // program is executed.
+  ClosureCompiler(Interpreter *interp, Environment *globals);
+  ~ClosureCompiler();
+
+  const ClosureCode *compile_program(Node *unit);
+  const ClosureCode *compile_program(FlatNode unit);
+
+  // Compile the body of a function, which must have been analyzed.
+  const ClosureCode *compile_function(Function *fn);
+
+  // Count the calls in progress, raising an error (see
+  // Interpreter::check_call_depth()) if there would be too many.
+  void enter_call();
+  void leave_call() { m_call_depth--; }
+
+private:
+  template<typename NodeRef>
+  void compile_unit(NodeRef unit);
+  template<typename NodeRef>
+  void compile_body(NodeRef body, unsigned num_params);
+  template<typename NodeRef>
+  const ExecNode *compile_statements(NodeRef node);
+  template<typename NodeRef>
+  const ExecNode *compile(NodeRef node);
+  template<typename NodeRef>
+  const ExecNode *compile_binary(NodeRef node);
+  template<typename NodeRef>
+  const ExecNode *compile_call(NodeRef node);
+  template<typename NodeRef>
+  const ExecNode *compile_function_def(NodeRef node);
+
+  void start(ClosureCode *out);
+  template<typename T>
+  T *new_node(ExecFn fn, const Location &loc);
+  const ExecNode **new_kids(unsigned num_kids);
+  const ExecNode *new_int(int value, const Location &loc);
+  const ExecNode *new_load(unsigned depth, unsigned slot, const Location &loc, Symbol name, bool function);
+};
+
+#endif // CLOSURE_H
@@ -0,0 +1,31 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+// How the virtual machines (VM and RegisterVM) dispatch instructions.
+//
+// If the compiler supports GCC's labels as values, the code is
+// direct-threaded: each instruction holds the address of its handler,
+// and each handler ends by jumping straight to the handler of the next
+// instruction, so every handler has its own (better predicted) indirect
+// branch.  Otherwise, or if MINILANG_SWITCH_DISPATCH is defined, each
+// instruction is dispatched by a switch on its opcode in a loop.
+#if defined(__GNUC__) && !defined(MINILANG_SWITCH_DISPATCH)
+#  define THREADED_DISPATCH 1
+#endif
+
+// These macros are used in a VM's execute() function, which must have
+// the variables ip (pointing to the next instruction), ins (pointing
+// to the instruction being executed), and num_executed.
+#ifdef THREADED_DISPATCH
+// Start the handler for an opcode.
+#  define HANDLER(op) op##_handler:
+// The address of the handler for an opcode, for the table of handlers.
+#  define HANDLER_ADDRESS(op) &&op##_handler
+// Execute the next instruction.
+#  define DISPATCH() do { ins = ip++; num_executed++; goto *ins->handler; } while (0)
+#else
+#  define HANDLER(op) case op:
+#  define DISPATCH() break
+#endif
+
+#endif // DISPATCH_H
@@ -2,14 +2,20 @@
 #define ENVIRONMENT_H
 
 #include <cassert>
-#include <map>
-#include <string>
+#include "symtab.h"
+#include "symbol_map.h"
 #include "value.h"
+#include "stats.h"
 
+// The variables of one scope.  Each variable is stored in a slot,
+// numbered from 0 in the order the variables are defined, so a
+// reference whose lexical address (see NodeBase::set_address())
+// was found by analysis can be evaluated without looking up its name.
+// A scope with only a few variables doesn't allocate any memory.
 class Environment {
 private:
   Environment *m_parent;
-  std::map<std::string, Value> variables; // Map of var names to their values
+  SymbolMap<Value> m_variables; // Map of var names to their values, indexed by slot
 
   // copy constructor and assignment operator prohibited
   Environment(const Environment &);
@@ -20,14 +26,40 @@ public:
 
   ~Environment();
 
-  void define_variable(const std::string& name, const Value& value);
+  Environment *get_parent() const { return m_parent; }
 
-  bool is_defined(const std::string& name) const;
-  bool is_defined_in_current(const std::string& name) const;
+  // Define a new variable in this scope.  Returns false (leaving the
+  // existing variable unchanged) if the scope already has a variable
+  // with the same name.
+  bool define_variable(Symbol name, const Value& value);
 
-  Value get_variable(const std::string& name) const;
+  // Remove all of the variables, so the environment can be reused
+  // for another execution of the same block.
+  void clear() { m_variables.clear(); }
 
-  void set_variable(const std::string& name, const Value& value);
+  // Define the same variables as another environment, in the same
+  // slots, with value 0.
+  void define_variables_of(const Environment &other);
+
+  // Look up a variable by name, searching this scope and then the
+  // enclosing scopes.  Returns the variable, or nullptr if it isn't
+  // defined, and sets depth and slot to its lexical address: the
+  // number of scopes out from this one to the one defining it, and
+  // its slot in that scope.
+  Value *lookup(Symbol name, unsigned &depth, unsigned &slot);
+
+  // Get the variable with the given lexical address, or nullptr if
+  // the scope at that depth doesn't have that many variables.
+  Value *get_slot(unsigned depth, unsigned slot) {
+    Stats::slot_lookups++;
+    Stats::slot_lookup_hops += depth;
+    Environment *env = this;
+    for (; depth > 0; depth--) {
+      env = env->m_parent;
+      assert(env != nullptr);
+    }
+    return slot < env->m_variables.size() ? &env->m_variables.value_at(slot) : nullptr;
+  }
 };
 
 #endif // ENVIRONMENT_H
@@ -0,0 +1,58 @@
+#include <cassert>
+#include "ast.h"
+#include "node.h"
+#include "parser2.h"
+#include "flat_ast.h"
+
+// The nodes are numbered in preorder using an explicit stack,
+// since the tree may be too deep to traverse recursively.
+FlatAST::FlatAST(Node *root) {
+  struct Pending {
+    Node *node;
+    uint32_t kid_slot;  // where the node's id goes in m_kids
+  };
+
+  m_kid_begin.push_back(0);
+  std::vector<Pending> stack;
+  stack.push_back({ root, ~0u });
+
+  while (!stack.empty()) {
+    Pending p = stack.back();
+    stack.pop_back();
+    Node *node = p.node;
+
+    if (node->get_tag() == AST_LAZY_STATEMENT_LIST) {
+      // the flattened tree can't be filled in later,
+      // so the body is parsed now
+      Parser2::parse_lazy_body(node);
+    }
+
+    uint32_t id = uint32_t(m_tags.size());
+    if (p.kid_slot != ~0u) {
+      m_kids[p.kid_slot] = id;
+    }
+
+    m_tags.push_back(uint16_t(node->get_tag()));
+    m_symbols.push_back(node->get_symbol());
+    m_int_values.push_back(node->get_int_value());
+    m_depths.push_back(node->get_depth());
+    m_slots.push_back(node->get_slot());
+    m_num_vars.push_back(node->get_num_vars());
+    m_strs.push_back(node->get_str());
+    m_locs.push_back(node->get_loc());
+
+    // reserve the node's list of children, which is filled in as
+    // the children are numbered (the lists are allocated in preorder,
+    // so they end up in the same order as the nodes)
+    uint32_t kid_begin = uint32_t(m_kids.size());
+    unsigned num_kids = node->get_num_kids();
+    m_kids.resize(kid_begin + num_kids);
+    m_kid_begin.push_back(kid_begin + num_kids);
+
+    for (unsigned i = num_kids; i > 0; i--) {
+      stack.push_back({ node->get_kid(i - 1), kid_begin + i - 1 });
+    }
+  }
+
+  assert(m_kid_begin.size() == m_tags.size() + 1);
+}
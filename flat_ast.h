@@ -0,0 +1,146 @@
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "symtab.h"
+#include "location.h"
+
+class Node;
+class FlatAST;
+
+// A reference to one node of a FlatAST.  It has the same accessors
+// as Node, including operator->, so that code templated on the node
+// type (such as Interpreter::evaluate()) can be written once for
+// both Node * and FlatNode.
+class FlatNode {
+private:
+  const FlatAST *m_ast;
+  uint32_t m_id;
+
+public:
+  FlatNode() : m_ast(nullptr), m_id(0) { }
+  FlatNode(const FlatAST *ast, uint32_t id) : m_ast(ast), m_id(id) { }
+
+  explicit operator bool() const { return m_ast != nullptr; }
+  const FlatNode *operator->() const { return this; }
+
+  uint32_t get_id() const { return m_id; }
+
+  inline int get_tag() const;
+  inline void set_tag(int tag) const;
+  inline unsigned get_num_kids() const;
+  inline FlatNode get_kid(unsigned index) const;
+  FlatNode get_last_kid() const { return get_kid(get_num_kids() - 1); }
+  inline Symbol get_symbol() const;
+  inline int get_int_value() const;
+  inline unsigned get_depth() const;
+  inline unsigned get_slot() const;
+  inline void set_address(unsigned depth, unsigned slot) const;
+  inline unsigned get_num_vars() const;
+  inline void set_num_vars(unsigned num_vars) const;
+  inline std::string_view get_str() const;
+  inline const Location &get_loc() const;
+};
+
+// A FlatAST is a copy of an AST laid out as parallel arrays indexed
+// by node id, with the nodes numbered in preorder.  The children of
+// each node are listed (by id) in one shared array, and the lists
+// are in the same order as their parents, so a node's children
+// are at kids[kid_begin[id]] up to kids[kid_begin[id + 1]].
+// The fields needed to walk the tree are kept apart from the ones
+// which are only needed to report errors or print the tree, so that
+// a traversal touches a few dense arrays rather than one
+// heap-allocated Node per step.
+class FlatAST {
+private:
+  friend class FlatNode;
+
+  // fields used when walking the tree (the tags of binary operators
+  // are changed when they're quickened by Interpreter::evaluate())
+  mutable std::vector<uint16_t> m_tags;
+  std::vector<uint32_t> m_kid_begin;  // one more entry than there are nodes
+  std::vector<uint32_t> m_kids;
+  std::vector<Symbol> m_symbols;
+  std::vector<int> m_int_values;      // value of each AST_INT_LITERAL
+
+  // lexical address of each AST_VARREF, and number of variables
+  // defined by each AST_STATEMENT_LIST, which are filled in
+  // by Interpreter::analyze() after the tree is flattened
+  mutable std::vector<uint32_t> m_depths;
+  mutable std::vector<uint32_t> m_slots;
+  mutable std::vector<uint32_t> m_num_vars;
+
+  // fields used for diagnostics
+  std::vector<std::string_view> m_strs;
+  std::vector<Location> m_locs;
+
+  // value semantics prohibited
+  FlatAST(const FlatAST &);
+  FlatAST &operator=(const FlatAST &);
+
+public:
+  // Flatten the AST with the given root.  Function bodies which
+  // haven't been parsed yet (AST_LAZY_STATEMENT_LIST) are parsed
+  // first.
+  explicit FlatAST(Node *root);
+
+  FlatNode get_root() const { return FlatNode(this, 0); }
+  unsigned get_num_nodes() const { return unsigned(m_tags.size()); }
+};
+
+inline int FlatNode::get_tag() const {
+  return m_ast->m_tags[m_id];
+}
+
+inline void FlatNode::set_tag(int tag) const {
+  m_ast->m_tags[m_id] = uint16_t(tag);
+}
+
+inline unsigned FlatNode::get_num_kids() const {
+  return m_ast->m_kid_begin[m_id + 1] - m_ast->m_kid_begin[m_id];
+}
+
+inline FlatNode FlatNode::get_kid(unsigned index) const {
+  return FlatNode(m_ast, m_ast->m_kids[m_ast->m_kid_begin[m_id] + index]);
+}
+
+inline Symbol FlatNode::get_symbol() const {
+  return m_ast->m_symbols[m_id];
+}
+
+inline int FlatNode::get_int_value() const {
+  return m_ast->m_int_values[m_id];
+}
+
+inline unsigned FlatNode::get_depth() const {
+  return m_ast->m_depths[m_id];
+}
+
+inline unsigned FlatNode::get_slot() const {
+  return m_ast->m_slots[m_id];
+}
+
+inline void FlatNode::set_address(unsigned depth, unsigned slot) const {
+  m_ast->m_depths[m_id] = depth;
+  m_ast->m_slots[m_id] = slot;
+}
+
+inline unsigned FlatNode::get_num_vars() const {
+  return m_ast->m_num_vars[m_id];
+}
+
+inline void FlatNode::set_num_vars(unsigned num_vars) const {
+  m_ast->m_num_vars[m_id] = num_vars;
+}
+
+inline std::string_view FlatNode::get_str() const {
+  return m_ast->m_strs[m_id];
+}
+
+inline const Location &FlatNode::get_loc() const {
+  return m_ast->m_locs[m_id];
+}
+
+#endif // FLAT_AST_H
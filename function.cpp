@@ -1,11 +1,26 @@
 #include "function.h"
 
-Function::Function(const std::string &name, const std::vector<std::string> &params, Environment *parent_env, Node *body)
+Function::Function(const std::string &name, const std::vector<Symbol> &params, Environment *parent_env, Node *body)
   : ValRep(VALREP_FUNCTION)
   , m_name(name)
   , m_params(params)
   , m_parent_env(parent_env)
-  , m_body(body) {
+  , m_body(body)
+  , m_bytecode(nullptr)
+  , m_register_code(nullptr)
+  , m_closure_code(nullptr) {
+}
+
+Function::Function(const std::string &name, const std::vector<Symbol> &params, Environment *parent_env, FlatNode body)
+  : ValRep(VALREP_FUNCTION)
+  , m_name(name)
+  , m_params(params)
+  , m_parent_env(parent_env)
+  , m_body(nullptr)
+  , m_flat_body(body)
+  , m_bytecode(nullptr)
+  , m_register_code(nullptr)
+  , m_closure_code(nullptr) {
 }
 
 Function::~Function() {
@@ -3,30 +3,47 @@
 
 #include <vector>
 #include <string>
+#include "symtab.h"
 #include "valrep.h"
+#include "flat_ast.h"
 class Environment;
 class Node;
+class Bytecode;
+class RegisterCode;
+class ClosureCode;
 
 class Function : public ValRep {
 private:
   std::string m_name;
-  std::vector<std::string> m_params;
+  std::vector<Symbol> m_params;
   Environment *m_parent_env;
   Node *m_body;
+  FlatNode m_flat_body;  // the body, if the function is defined in a FlatAST
+  const Bytecode *m_bytecode;  // the compiled body, if it has been compiled
+  const RegisterCode *m_register_code;  // the body compiled for RegisterVM
+  const ClosureCode *m_closure_code;    // the body compiled by ClosureCompiler
 
   // value semantics prohibited
   Function(const Function &);
   Function &operator=(const Function &);
 
 public:
-  Function(const std::string &name, const std::vector<std::string> &params, Environment *parent_env, Node *body);
+  Function(const std::string &name, const std::vector<Symbol> &params, Environment *parent_env, Node *body);
+  Function(const std::string &name, const std::vector<Symbol> &params, Environment *parent_env, FlatNode body);
   virtual ~Function();
 
   std::string get_name() const { return m_name; }
-  const std::vector<std::string> &get_params() const { return m_params; }
+  const std::vector<Symbol> &get_params() const { return m_params; }
   unsigned get_num_params() const { return unsigned(m_params.size()); }
   Environment *get_parent_env() const { return m_parent_env; }
   Node *get_body() const { return m_body; }
+  FlatNode get_flat_body() const { return m_flat_body; }
+  const Bytecode *get_bytecode() const { return m_bytecode; }
+  void set_bytecode(const Bytecode *bytecode) { m_bytecode = bytecode; }
+  const RegisterCode *get_register_code() const { return m_register_code; }
+  void set_register_code(const RegisterCode *code) { m_register_code = code; }
+  const ClosureCode *get_closure_code() const { return m_closure_code; }
+  void set_closure_code(const ClosureCode *code) { m_closure_code = code; }
 };
 
 #endif // FUNCTION_H
@@ -4,53 +4,156 @@
 #include <unordered_set>
 #include "ast.h"
 #include "node.h"
+#include "ast_arena.h"
+#include "flat_ast.h"
 #include "exceptions.h"
 #include "function.h"
+#include "parser2.h"
 #include "interp.h"
 #include "environment.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "regcode.h"
+#include "regvm.h"
+#include "closure.h"
+#include "binary_op.h"
+#include "stats.h"
 
-Interpreter::Interpreter(Node *ast_to_adopt)
-  : m_ast(ast_to_adopt), m_env(new Environment(nullptr)) {
+namespace {
+
+// Overloads for the parts of analysis and evaluation which
+// differ between Node and FlatNode
+
+Node *get_body(Function *fn, Node *) {
+    return fn->get_body();
+}
+
+FlatNode get_body(Function *fn, FlatNode) {
+    return fn->get_flat_body();
+}
+
+// Get the variable a reference (whose lexical address has been found)
+// refers to
+template<typename NodeRef>
+Value *get_variable(NodeRef varref, Environment& env) {
+    Value *var = env.get_slot(varref->get_depth(), varref->get_slot());
+    if (var == nullptr) {
+        RuntimeError::raise("Undefined variable '%s' during execution.", SymbolTable::get_name(varref->get_symbol()).c_str());
+    }
+    return var;
+}
+
+// Return a quickened binary operator node, whose operator's variants
+// start at the tag quick, to the operator's generic variant
+template<typename NodeRef>
+void despecialize(NodeRef node, int quick) {
+    node->set_tag(quick + QUICK_GENERIC);
+    Stats::nodes_despecialized++;
+}
+
+}
+
+Interpreter::Interpreter(Node *ast, ASTArena *arena_to_adopt)
+  : m_ast(ast), m_arena(arena_to_adopt), m_flat_ast(nullptr), m_env(new Environment(nullptr))
+  , m_compiler(nullptr), m_program(nullptr), m_reg_compiler(nullptr), m_reg_program(nullptr)
+  , m_closure_compiler(nullptr), m_closure_program(nullptr), m_call_depth(0) {
 
     // Bind intrinsic functions
-    m_env->define_variable("print", Value(&Interpreter::intrinsic_print));
-    m_env->define_variable("println", Value(&Interpreter::intrinsic_println));
+    m_env->define_variable(SymbolTable::intern("print"), Value(&Interpreter::intrinsic_print));
+    m_env->define_variable(SymbolTable::intern("println"), Value(&Interpreter::intrinsic_println));
 }
 
-Interpreter::Interpreter(Node *ast_to_adopt, Environment *env)
-  : m_ast(ast_to_adopt), m_env(new Environment(env)) {
+Interpreter::Interpreter(Node *ast, ASTArena *arena_to_adopt, Environment *env)
+  : m_ast(ast), m_arena(arena_to_adopt), m_flat_ast(nullptr), m_env(new Environment(env))
+  , m_compiler(nullptr), m_program(nullptr), m_reg_compiler(nullptr), m_reg_program(nullptr)
+  , m_closure_compiler(nullptr), m_closure_program(nullptr), m_call_depth(0) {
 
     // Bind intrinsic functions
-    m_env->define_variable("print", Value(&Interpreter::intrinsic_print));
-    m_env->define_variable("println", Value(&Interpreter::intrinsic_println));
+    m_env->define_variable(SymbolTable::intern("print"), Value(&Interpreter::intrinsic_print));
+    m_env->define_variable(SymbolTable::intern("println"), Value(&Interpreter::intrinsic_println));
 }
 
 Interpreter::~Interpreter() {
-  delete m_ast;
+  delete m_compiler;
+  delete m_reg_compiler;
+  delete m_closure_compiler;
   delete m_env;
+  delete m_flat_ast;
+  delete m_arena;
 }
 
-void Interpreter::analyze_node(Node* node, Environment& env) {
+void Interpreter::flatten_ast() {
+  if (m_flat_ast == nullptr) {
+    m_flat_ast = new FlatAST(m_ast);
+  }
+}
+
+template<typename NodeRef>
+void Interpreter::analyze_node(NodeRef node, Environment& env) {
     if (!node) return;
 
     switch (node->get_tag()) {
         case AST_VARDEF: {
-            Node* var_name_node = node->get_kid(0);
-            std::string var_name = var_name_node->get_str();
-            if (env.is_defined_in_current(var_name)) {
-               EvaluationError::raise(node->get_loc(), "Variable '%s' already defined in this scope.", var_name.c_str());
+            NodeRef var_name_node = node->get_kid(0);
+            Symbol var_name = var_name_node->get_symbol();
+            if (!env.define_variable(var_name, Value(0))) { // Define with default value 0
+               EvaluationError::raise(node->get_loc(), "Variable '%s' already defined in this scope.", SymbolTable::get_name(var_name).c_str());
             }
-            env.define_variable(var_name, Value(0)); // Define with default value 0
             return;
         }
         case AST_VARREF: {
-            std::string var_name = node->get_str();
-            if (!env.is_defined(var_name)) {
-                SemanticError::raise(node->get_loc(), "Variable '%s' referenced before definition.", var_name.c_str());
+            Symbol var_name = node->get_symbol();
+            unsigned depth, slot;
+            if (env.lookup(var_name, depth, slot) == nullptr) {
+                SemanticError::raise(node->get_loc(), "Variable '%s' referenced before definition.", SymbolTable::get_name(var_name).c_str());
+            }
+            node->set_address(depth, slot);
+            return;
+        }
+        case AST_FUNCTION: {
+            // Define the function's name first, so that its body
+            // can call it recursively
+            Symbol fn_name = node->get_kid(0)->get_symbol();
+            if (!env.define_variable(fn_name, Value(0))) {
+               EvaluationError::raise(node->get_loc(), "Variable '%s' already defined in this scope.", SymbolTable::get_name(fn_name).c_str());
+            }
+
+            // Parameters are defined in their own scope, which
+            // encloses the body
+            Environment fn_env(&env);
+            if (node->get_num_kids() > 2) {
+                NodeRef param_list = node->get_kid(1);
+                for (unsigned i = 0; i < param_list->get_num_kids(); ++i) {
+                    NodeRef param = param_list->get_kid(i);
+                    if (!fn_env.define_variable(param->get_symbol(), Value(0))) {
+                        EvaluationError::raise(param->get_loc(), "Variable '%s' already defined in this scope.", SymbolTable::get_name(param->get_symbol()).c_str());
+                    }
+                }
+            }
+            // A body that hasn't been parsed yet is analyzed
+            // when it is parsed (see analyze_lazy_body())
+            if (node->get_last_kid()->get_tag() != AST_LAZY_STATEMENT_LIST) {
+                analyze_node(node->get_last_kid(), fn_env);
             }
             return;
         }
         case AST_STATEMENT_LIST: {
+            // Only a block which defines variables gets a new scope
+            // (the lexical addresses found here must match the
+            // scopes created by evaluate())
+            unsigned num_vars = 0;
+            for (unsigned i = 0; i < node->get_num_kids(); ++i) {
+                if (node->get_kid(i)->get_kid(0)->get_tag() == AST_VARDEF) {
+                    num_vars++;
+                }
+            }
+            node->set_num_vars(num_vars);
+            if (num_vars == 0) {
+                for (unsigned i = 0; i < node->get_num_kids(); ++i) {
+                    analyze_node(node->get_kid(i), env);
+                }
+                return;
+            }
             Environment block_env(&env); // New scope
             for (unsigned i = 0; i < node->get_num_kids(); ++i) {
                 analyze_node(node->get_kid(i), block_env);
@@ -68,83 +171,95 @@ void Interpreter::analyze_node(Node* node, Environment& env) {
 
 // Analyze the AST for variable usage by leveraging the Environment class
 void Interpreter::analyze() {
-    // Create a new environment for analysis phase
-    Environment analysis_env(m_env);
-    analyze_node(m_ast, analysis_env);
+    // Create a new environment for analysis phase, with the same
+    // variables (in the same slots) as the global environment, since
+    // the program is executed in the global environment itself
+    Environment analysis_env(m_env->get_parent());
+    analysis_env.define_variables_of(*m_env);
+    if (m_flat_ast != nullptr) {
+        analyze_node(m_flat_ast->get_root(), analysis_env);
+    } else {
+        analyze_node(m_ast, analysis_env);
+    }
+}
+
+// Parse and analyze the body of a function whose body was skipped by
+// the parser.  The body is analyzed in the function's defining
+// environment as it is now, rather than as it was at the point of
+// definition, so references to variables defined after the function
+// are (harmlessly) accepted.
+void Interpreter::analyze_lazy_body(Function *fn) {
+    Parser2::parse_lazy_body(fn->get_body());
+
+    Environment fn_env(fn->get_parent_env());
+    const std::vector<Symbol>& params = fn->get_params();
+    for (auto i = params.begin(); i != params.end(); ++i) {
+        fn_env.define_variable(*i, Value(0));
+    }
+    analyze_node(fn->get_body(), fn_env);
+}
+
+Function *Interpreter::check_call(const Value &fn_val, unsigned num_args, const Location &loc, Symbol name) {
+    if (fn_val.get_kind() != VALUE_FUNCTION) {
+        EvaluationError::raise(loc, "'%s' is not a function.", SymbolTable::get_name(name).c_str());
+    }
+    Function *fn = fn_val.get_function();
+    if (!fn->get_flat_body() && fn->get_body()->get_tag() == AST_LAZY_STATEMENT_LIST) {
+        analyze_lazy_body(fn);
+    }
+    if (num_args != fn->get_num_params()) {
+        EvaluationError::raise(loc, "Incorrect number of arguments for function '%s'.", SymbolTable::get_name(name).c_str());
+    }
+    return fn;
 }
 
 // Helper function to evaluate expressions
-Value Interpreter::evaluate(Node* node, Environment& env) {
+template<typename NodeRef>
+Value Interpreter::evaluate(NodeRef node, Environment& env) {
     if (!node) {
         RuntimeError::raise("Null node encountered during evaluation.");
     }
+    Stats::nodes_evaluated++;
 
     switch (node->get_tag()) {
         case AST_INT_LITERAL: {
-            int val = std::stoi(node->get_str());
-            return Value(val);
-        }
-        case AST_VARREF: {
-            std::string var_name = node->get_str();
-            if (!env.is_defined(var_name)) {
-                RuntimeError::raise("Undefined variable '%s' during execution.", var_name.c_str());
-            }
-            return env.get_variable(var_name);
+            return Value(node->get_int_value());
         }
+        case AST_VARREF:
+            return *get_variable(node, env);
         case AST_VARDEF: {
-            Node* var_name_node = node->get_kid(0);
+            NodeRef var_name_node = node->get_kid(0);
             assert(var_name_node->get_tag() == AST_VARREF);
-            std::string var_name = var_name_node->get_str();
-            if (env.is_defined_in_current(var_name)) {
-                EvaluationError::raise(node->get_loc(), "Variable '%s' already defined in this scope.", var_name.c_str());
+            Symbol var_name = var_name_node->get_symbol();
+            if (!env.define_variable(var_name, Value(0))) { // Define with default value 0
+                EvaluationError::raise(node->get_loc(), "Variable '%s' already defined in this scope.", SymbolTable::get_name(var_name).c_str());
             }
-            env.define_variable(var_name, Value(0)); // Define with default value 0
             return Value(0);
         }
         case AST_ASSIGN: {
-            Node* var_ref_node = node->get_kid(0);
-            Node* expr_node = node->get_kid(1);
-            std::string var_name = var_ref_node->get_str();
+            NodeRef var_ref_node = node->get_kid(0);
+            NodeRef expr_node = node->get_kid(1);
             Value expr_val = evaluate(expr_node, env);
-            if (!env.is_defined(var_name)) {
-                SemanticError::raise(node->get_loc(), "Assignment to undefined variable '%s'.", var_name.c_str());
+            Value *var = env.get_slot(var_ref_node->get_depth(), var_ref_node->get_slot());
+            if (var == nullptr) {
+                SemanticError::raise(node->get_loc(), "Assignment to undefined variable '%s'.", SymbolTable::get_name(var_ref_node->get_symbol()).c_str());
             }
-            env.set_variable(var_name, expr_val);
+            *var = expr_val;
             return expr_val;
         }
 
-        // Binary operations
-        case AST_ADD: {
-            Node* left_node = node->get_kid(0);
-            Node* right_node = node->get_kid(1);
-            Value left_val = evaluate(left_node, env);
-            Value right_val = evaluate(right_node, env);
-            return Value(left_val.get_ival() + right_val.get_ival());
-        }
-        case AST_SUB: {
-            Node* left_node = node->get_kid(0);
-            Node* right_node = node->get_kid(1);
-            Value left_val = evaluate(left_node, env);
-            Value right_val = evaluate(right_node, env);
-            return Value(left_val.get_ival() - right_val.get_ival());
-        }
-        case AST_MULTIPLY: {
-            Node* left_node = node->get_kid(0);
-            Node* right_node = node->get_kid(1);
-            Value left_val = evaluate(left_node, env);
-            Value right_val = evaluate(right_node, env);
-            return Value(left_val.get_ival() * right_val.get_ival());
-        }
-        case AST_DIVIDE: {
-            Node* left_node = node->get_kid(0);
-            Node* right_node = node->get_kid(1);
-            Value left_val = evaluate(left_node, env);
-            Value right_val = evaluate(right_node, env);
-            if (right_val.get_ival() == 0) {
-                EvaluationError::raise(node->get_loc(), "Division by zero.");
-            }
-            return Value(left_val.get_ival() / right_val.get_ival());
-        }
+        // Binary operations, which are quickened: the first time an
+        // operator node is evaluated with int operands, its tag is changed
+        // to a variant of the operator specialized for its operands
+#define BINARY_OPERATOR_CASES(op) \
+        case AST_##op:             return evaluate_unquickened<AST_##op, AST_##op##_INT_INT>(node, env); \
+        case AST_##op##_INT_INT:   return evaluate_int_int<AST_##op, AST_##op##_INT_INT>(node, env); \
+        case AST_##op##_VAR_CONST: return evaluate_var_const<AST_##op, AST_##op##_INT_INT>(node, env); \
+        case AST_##op##_VAR_VAR:   return evaluate_var_var<AST_##op, AST_##op##_INT_INT>(node, env); \
+        case AST_##op##_GENERIC:   return evaluate_generic<AST_##op>(node, env);
+        AST_BINARY_OPERATORS(BINARY_OPERATOR_CASES)
+#undef BINARY_OPERATOR_CASES
+
         case AST_LOGICAL_AND: {
             Value left_val = evaluate(node->get_kid(0), env);
             if (!left_val.is_int()) {
@@ -177,50 +292,8 @@ Value Interpreter::evaluate(Node* node, Environment& env) {
                 return Value(right_val.get_ival() != 0 ? 1 : 0);
             }
         }
-        case AST_GREATER: {
-            Node* left_node = node->get_kid(0);
-            Node* right_node = node->get_kid(1);
-            Value left_val = evaluate(left_node, env);
-            Value right_val = evaluate(right_node, env);
-            return Value(left_val.get_ival() > right_val.get_ival() ? 1 : 0);
-        }
-        case AST_GREATER_EQUAL: {
-            Node* left_node = node->get_kid(0);
-            Node* right_node = node->get_kid(1);
-            Value left_val = evaluate(left_node, env);
-            Value right_val = evaluate(right_node, env);
-            return Value(left_val.get_ival() >= right_val.get_ival() ? 1 : 0);
-        }
-        case AST_LESS: {
-            Node* left_node = node->get_kid(0);
-            Node* right_node = node->get_kid(1);
-            Value left_val = evaluate(left_node, env);
-            Value right_val = evaluate(right_node, env);
-            return Value(left_val.get_ival() < right_val.get_ival() ? 1 : 0);
-        }
-        case AST_LESS_EQUAL: {
-            Node* left_node = node->get_kid(0);
-            Node* right_node = node->get_kid(1);
-            Value left_val = evaluate(left_node, env);
-            Value right_val = evaluate(right_node, env);
-            return Value(left_val.get_ival() <= right_val.get_ival() ? 1 : 0);
-        }
-        case AST_EQUAL: {
-            Node* left_node = node->get_kid(0);
-            Node* right_node = node->get_kid(1);
-            Value left_val = evaluate(left_node, env);
-            Value right_val = evaluate(right_node, env);
-            return Value(left_val.get_ival() == right_val.get_ival() ? 1 : 0);
-        }
-        case AST_NOT_EQUAL: {
-            Node* left_node = node->get_kid(0);
-            Node* right_node = node->get_kid(1);
-            Value left_val = evaluate(left_node, env);
-            Value right_val = evaluate(right_node, env);
-            return Value(left_val.get_ival() != right_val.get_ival() ? 1 : 0);
-        }
         case AST_STATEMENT: {
-            Node* stmt_node = node->get_kid(0);
+            NodeRef stmt_node = node->get_kid(0);
             return evaluate(stmt_node, env);
         }
         case AST_UNIT: {
@@ -231,13 +304,17 @@ Value Interpreter::evaluate(Node* node, Environment& env) {
             return last_val;
         }
         case AST_FNCALL: {
-            Node* func_varref_node = node->get_kid(0);
-            std::string func_name = func_varref_node->get_str();
-            Value func_val = env.get_variable(func_name);
+            NodeRef func_varref_node = node->get_kid(0);
+            Symbol func_name = func_varref_node->get_symbol();
+            Value *func_var = env.get_slot(func_varref_node->get_depth(), func_varref_node->get_slot());
+            if (func_var == nullptr) {
+                RuntimeError::raise("Undefined variable: '%s'", SymbolTable::get_name(func_name).c_str());
+            }
+            Value func_val = *func_var;
 
             std::vector<Value> arg_values;
             if (node->get_num_kids() > 1) {
-                Node* arg_list_node = node->get_kid(1);
+                NodeRef arg_list_node = node->get_kid(1);
                 for (unsigned i = 0; i < arg_list_node->get_num_kids(); ++i) {
                     Value arg_val = evaluate(arg_list_node->get_kid(i), env);
                     arg_values.push_back(arg_val);
@@ -247,53 +324,71 @@ Value Interpreter::evaluate(Node* node, Environment& env) {
             if (func_val.is_intrinsic_fn()) {
                 IntrinsicFn intrinsic_fn = func_val.get_intrinsic_fn();
                 return intrinsic_fn(arg_values.data(), arg_values.size(), node->get_loc(), this);
-            } else if (func_val.get_kind() == VALUE_FUNCTION) {
-                Function* user_fn = func_val.get_function();
-                const std::vector<std::string>& param_names = user_fn->get_params();
+            }
 
-                if (arg_values.size() != param_names.size()) {
-                    EvaluationError::raise(node->get_loc(), "Incorrect number of arguments for function '%s'.", func_name.c_str());
-                }
+            Function* user_fn = check_call(func_val, unsigned(arg_values.size()), node->get_loc(), func_name);
+            const std::vector<Symbol>& param_names = user_fn->get_params();
 
-                // Create function call environment with parent as the function's defining environment
-                Environment fn_env(user_fn->get_parent_env());
+            // Create function call environment with parent as the function's defining environment
+            Environment fn_env(user_fn->get_parent_env());
 
-                // Bind arguments to parameters in the function's environment
-                for (size_t i = 0; i < arg_values.size(); ++i) {
-                    fn_env.define_variable(param_names[i], arg_values[i]);
-                }
+            // Bind arguments to parameters in the function's environment
+            for (size_t i = 0; i < arg_values.size(); ++i) {
+                fn_env.define_variable(param_names[i], arg_values[i]);
+            }
 
-                // Evaluate the function body in the new environment
-                Value result = evaluate(user_fn->get_body(), fn_env);
-                return result;
-            } else {
-                EvaluationError::raise(node->get_loc(), "'%s' is not a function.", func_name.c_str());
+            // Evaluate the function body in the new environment
+            check_call_depth(m_call_depth);
+            m_call_depth++;
+            Value result = evaluate(get_body(user_fn, node), fn_env);
+            m_call_depth--;
+            return result;
+        }
+        case AST_FUNCTION: {
+            // Bind the function's name to a Function value whose
+            // parent environment is the defining environment
+            NodeRef func_name_node = node->get_kid(0);
+            std::vector<Symbol> params;
+            if (node->get_num_kids() > 2) {
+                NodeRef param_list = node->get_kid(1);
+                for (unsigned i = 0; i < param_list->get_num_kids(); ++i) {
+                    params.push_back(param_list->get_kid(i)->get_symbol());
+                }
+            }
+            Function* fn = new Function(std::string(func_name_node->get_str()), params, &env, node->get_last_kid());
+            if (!env.define_variable(func_name_node->get_symbol(), Value(fn))) {
+                EvaluationError::raise(node->get_loc(), "Variable '%s' already defined in this scope.", SymbolTable::get_name(func_name_node->get_symbol()).c_str());
             }
+            return Value(0); // Function definitions evaluate to 0
         }
         case AST_IF: {
-            Node* condition_node = node->get_kid(0);
-            Node* true_branch_node = node->get_kid(1);
-            Node* false_branch_node = node->get_num_kids() > 2 ? node->get_kid(2) : nullptr;
+            NodeRef condition_node = node->get_kid(0);
+            NodeRef true_branch_node = node->get_kid(1);
 
             Value condition_val = evaluate(condition_node, env);
             if (!condition_val.is_int()) {
                 EvaluationError::raise(node->get_loc(), "Condition must evaluate to an integer");
             }
 
+            // The branches are blocks, which create scopes
+            // of their own if they need them
             if (condition_val.get_ival() != 0) {
                 // True branch
-                Environment true_env(&env);
-                evaluate(true_branch_node, true_env);
-            } else if (false_branch_node != nullptr) {
+                evaluate(true_branch_node, env);
+            } else if (node->get_num_kids() > 2) {
                 // False branch
-                Environment false_env(&env);
-                evaluate(false_branch_node, false_env);
+                evaluate(node->get_kid(2), env);
             }
             return Value(0); // Control flow statements evaluate to 0
         }
         case AST_WHILE: {
-            Node* condition_node = node->get_kid(0);
-            Node* body_node = node->get_kid(1);
+            NodeRef condition_node = node->get_kid(0);
+            NodeRef body_node = node->get_kid(1);
+
+            // If the body defines variables, they are defined in
+            // one scope, which is cleared for each iteration
+            Environment body_env(&env);
+            Environment &loop_env = (body_node->get_num_vars() > 0) ? body_env : env;
 
             while (true) {
                 Value condition_val = evaluate(condition_node, env);
@@ -306,19 +401,17 @@ Value Interpreter::evaluate(Node* node, Environment& env) {
                 }
 
                 // Loop body
-                Environment body_env(&env);
-                evaluate(body_node, body_env);
+                body_env.clear();
+                evaluate_statements(body_node, loop_env);
             }
             return Value(0); // Control flow statements evaluate to 0
         }
         case AST_STATEMENT_LIST: {
-            Value last_val(0);
-            Environment block_env(&env); 
-            for (unsigned i = 0; i < node->get_num_kids(); ++i) {
-                Node* stmt_node = node->get_kid(i);
-                last_val = evaluate(stmt_node, block_env);
+            if (node->get_num_vars() == 0) {
+                return evaluate_statements(node, env);
             }
-            return last_val;
+            Environment block_env(&env);
+            return evaluate_statements(node, block_env);
         }
         default:
             RuntimeError::raise("Unknown AST node type %d during evaluation.", node->get_tag());
@@ -326,11 +419,141 @@ Value Interpreter::evaluate(Node* node, Environment& env) {
     return Value(0); // Unreachable
 }
 
+// Evaluate a binary operator node which hasn't been quickened.  If its
+// operands are ints, it becomes the variant of its operator (whose
+// variants start at the tag Quick) which is specialized for them.
+template<int Op, int Quick, typename NodeRef>
+Value Interpreter::evaluate_unquickened(NodeRef node, Environment& env) {
+    NodeRef left_node = node->get_kid(0);
+    NodeRef right_node = node->get_kid(1);
+    Value left_val = evaluate(left_node, env);
+    Value right_val = evaluate(right_node, env);
+    if (left_val.is_int() && right_val.is_int()) {
+        int variant = QUICK_INT_INT;
+        if (left_node->get_tag() == AST_VARREF && right_node->get_tag() == AST_INT_LITERAL) {
+            variant = QUICK_VAR_CONST;
+        } else if (left_node->get_tag() == AST_VARREF && right_node->get_tag() == AST_VARREF) {
+            variant = QUICK_VAR_VAR;
+        }
+        node->set_tag(Quick + variant);
+        Stats::nodes_quickened++;
+    }
+    return apply_binary_op<BinaryOp<Op>>(left_val, right_val, node->get_loc());
+}
+
+// The specialized variants of a binary operator are de-specialized if
+// an operand isn't an int, and then fall back to the generic variant's
+// apply_binary_op(), which reports the operand as an error.  The
+// variants whose operands are variables or literals use them directly,
+// rather than evaluating them.
+
+template<int Op, int Quick, typename NodeRef>
+Value Interpreter::evaluate_int_int(NodeRef node, Environment& env) {
+    Value left_val = evaluate(node->get_kid(0), env);
+    Value right_val = evaluate(node->get_kid(1), env);
+    if (!left_val.is_int() || !right_val.is_int()) {
+        despecialize(node, Quick);
+        return apply_binary_op<BinaryOp<Op>>(left_val, right_val, node->get_loc());
+    }
+    return Value(BinaryOp<Op>::apply(left_val.get_ival(), right_val.get_ival(), node->get_loc()));
+}
+
+template<int Op, int Quick, typename NodeRef>
+Value Interpreter::evaluate_var_const(NodeRef node, Environment& env) {
+    const Value *left_var = get_variable(node->get_kid(0), env);
+    if (!left_var->is_int()) {
+        despecialize(node, Quick);
+        return apply_binary_op<BinaryOp<Op>>(*left_var, Value(node->get_kid(1)->get_int_value()), node->get_loc());
+    }
+    return Value(BinaryOp<Op>::apply(left_var->get_ival(), node->get_kid(1)->get_int_value(), node->get_loc()));
+}
+
+template<int Op, int Quick, typename NodeRef>
+Value Interpreter::evaluate_var_var(NodeRef node, Environment& env) {
+    const Value *left_var = get_variable(node->get_kid(0), env);
+    const Value *right_var = get_variable(node->get_kid(1), env);
+    if (!left_var->is_int() || !right_var->is_int()) {
+        despecialize(node, Quick);
+        return apply_binary_op<BinaryOp<Op>>(*left_var, *right_var, node->get_loc());
+    }
+    return Value(BinaryOp<Op>::apply(left_var->get_ival(), right_var->get_ival(), node->get_loc()));
+}
+
+template<int Op, typename NodeRef>
+Value Interpreter::evaluate_generic(NodeRef node, Environment& env) {
+    Value left_val = evaluate(node->get_kid(0), env);
+    Value right_val = evaluate(node->get_kid(1), env);
+    return apply_binary_op<BinaryOp<Op>>(left_val, right_val, node->get_loc());
+}
+
+// Evaluate the statements of a block in the given scope
+template<typename NodeRef>
+Value Interpreter::evaluate_statements(NodeRef node, Environment& env) {
+    Value last_val(0);
+    for (unsigned i = 0; i < node->get_num_kids(); ++i) {
+        NodeRef stmt_node = node->get_kid(i);
+        last_val = evaluate(stmt_node, env);
+    }
+    return last_val;
+}
+
+void Interpreter::compile_bytecode() {
+    if (m_compiler == nullptr) {
+        m_compiler = new BytecodeCompiler(m_env);
+        if (m_flat_ast != nullptr) {
+            m_program = m_compiler->compile_program(m_flat_ast->get_root());
+        } else {
+            m_program = m_compiler->compile_program(m_ast);
+        }
+    }
+}
+
+void Interpreter::compile_registers() {
+    if (m_reg_compiler == nullptr) {
+        m_reg_compiler = new RegisterCompiler(m_env);
+        if (m_flat_ast != nullptr) {
+            m_reg_program = m_reg_compiler->compile_program(m_flat_ast->get_root());
+        } else {
+            m_reg_program = m_reg_compiler->compile_program(m_ast);
+        }
+    }
+}
+
+void Interpreter::compile_closures() {
+    if (m_closure_compiler == nullptr) {
+        m_closure_compiler = new ClosureCompiler(this, m_env);
+        if (m_flat_ast != nullptr) {
+            m_closure_program = m_closure_compiler->compile_program(m_flat_ast->get_root());
+        } else {
+            m_closure_program = m_closure_compiler->compile_program(m_ast);
+        }
+    }
+}
+
 // Execute the program
 Value Interpreter::execute() {
+    if (m_closure_program != nullptr) {
+        std::vector<Value> locals(m_closure_program->get_num_locals());
+        return m_closure_program->execute(locals.data());
+    }
+    if (m_reg_program != nullptr) {
+        RegisterVM vm(this, m_reg_compiler, m_env);
+        return vm.execute(m_reg_program);
+    }
+    if (m_program != nullptr) {
+        VM vm(this, m_compiler, m_env);
+        return vm.execute(m_program);
+    }
+    if (m_flat_ast != nullptr) {
+        return evaluate(m_flat_ast->get_root(), *m_env);
+    }
     return evaluate(m_ast, *m_env);
 }
 
+void Interpreter::call_depth_exceeded() {
+    RuntimeError::raise("Maximum call depth of %u exceeded.", MAX_CALL_DEPTH);
+}
+
 Value Interpreter::intrinsic_print(Value args[], unsigned num_args, const Location &loc, Interpreter *interp) {
     if (num_args != 1) {
         EvaluationError::raise(loc, "print expects exactly one argument");
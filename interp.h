@@ -4,27 +4,106 @@
 #include "value.h"
 #include "environment.h"
 class Node;
+class ASTArena;
+class FlatAST;
 class Location;
+class Function;
+class Bytecode;
+class BytecodeCompiler;
+class RegisterCode;
+class RegisterCompiler;
+class ClosureCode;
+class ClosureCompiler;
 
 class Interpreter {
 private:
   Node *m_ast;
+  ASTArena *m_arena;  // owns the AST's nodes
+  FlatAST *m_flat_ast;
   Environment *m_env;
+  BytecodeCompiler *m_compiler;
+  const Bytecode *m_program;  // the compiled program, if it has been compiled
+  RegisterCompiler *m_reg_compiler;
+  const RegisterCode *m_reg_program;  // the program compiled for RegisterVM
+  ClosureCompiler *m_closure_compiler;
+  const ClosureCode *m_closure_program;  // the program compiled by ClosureCompiler
+  unsigned m_call_depth;  // calls in progress in evaluate()
 
 public:
-  Interpreter(Node *ast_to_adopt);
-  Interpreter(Node *ast_to_adopt, Environment *env);
+  Interpreter(Node *ast, ASTArena *arena_to_adopt);
+  Interpreter(Node *ast, ASTArena *arena_to_adopt, Environment *env);
   ~Interpreter();
 
+  // Convert the AST to a FlatAST, which analyze() and execute()
+  // then walk instead of the Nodes.  Must be called before analyze().
+  void flatten_ast();
+
+  // Check the program's variable references, and find their lexical
+  // addresses.  Must be called before execute().
   void analyze();
+
+  // Compile the program to Bytecode, which execute() then runs on a
+  // VM rather than evaluating the AST.  Must be called after analyze().
+  void compile_bytecode();
+
+  // Compile the program to RegisterCode, which execute() then runs on
+  // a RegisterVM.  Must be called after analyze().
+  void compile_registers();
+
+  // Compile the program to a tree of ExecNodes, which execute()
+  // then runs.  Must be called after analyze().
+  void compile_closures();
+
   Value execute();
 
+  // Check that a call's callee is a function (other than an
+  // intrinsic) which can be called with the number of arguments
+  // given, and get it, analyzing its body if it hasn't been.  Every
+  // engine makes its calls' checks here, so they report the same
+  // errors in the same order.  The location and name are the call's,
+  // for the errors.
+  Function *check_call(const Value &fn_val, unsigned num_args, const Location &loc, Symbol name);
+
+  // The most calls (of functions other than intrinsics) which may be
+  // in progress at once.  Every engine raises the same error when a
+  // call would exceed it, so deep recursion fails in the same way
+  // whether it would have exhausted the native stack (as evaluate()
+  // does) or memory (as the virtual machines do).
+  static const unsigned MAX_CALL_DEPTH = 1000;
+
+  // Raise an error if a call can't be made while depth calls are in
+  // progress.
+  static void check_call_depth(size_t depth) {
+    if (depth >= MAX_CALL_DEPTH) {
+      call_depth_exceeded();
+    }
+  }
+
 private:
-    // Helper functions for analysis
-    void analyze_node(Node* node, Environment& env);
+    // Helper functions for analysis and execution, which work on
+    // either representation of the AST: NodeRef is Node * or FlatNode
+    template<typename NodeRef>
+    void analyze_node(NodeRef node, Environment& env);
+    void analyze_lazy_body(Function *fn);
+
+    template<typename NodeRef>
+    Value evaluate(NodeRef node, Environment& env);
+    template<typename NodeRef>
+    Value evaluate_statements(NodeRef node, Environment& env);
+
+    // Evaluate each variant of a binary operator (see evaluate())
+    template<int Op, int Quick, typename NodeRef>
+    Value evaluate_unquickened(NodeRef node, Environment& env);
+    template<int Op, int Quick, typename NodeRef>
+    Value evaluate_int_int(NodeRef node, Environment& env);
+    template<int Op, int Quick, typename NodeRef>
+    Value evaluate_var_const(NodeRef node, Environment& env);
+    template<int Op, int Quick, typename NodeRef>
+    Value evaluate_var_var(NodeRef node, Environment& env);
+    template<int Op, typename NodeRef>
+    Value evaluate_generic(NodeRef node, Environment& env);
 
-    // Helper functions for execution
-    Value evaluate(Node* node, Environment& env);
+    [[noreturn]] static void call_depth_exceeded();
 
     static Value intrinsic_print(Value args[], unsigned num_args, const Location &loc, Interpreter *interp);
     static Value intrinsic_println(Value args[], unsigned num_args, const Location &loc, Interpreter *interp);
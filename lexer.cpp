@@ -1,44 +1,147 @@
 #include <map>
+#include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <cstring>
 #include <string>
 #include "cpputil.h"
 #include "token.h"
 #include "exceptions.h"
+#include "thread_pool.h"
 #include "lexer.h"
 #include <iostream>
 
+namespace {
+
+////////////////////////////////////////////////////////////////////////
+// Keyword recognition
+////////////////////////////////////////////////////////////////////////
+
+struct Keyword {
+  const char *text;
+  unsigned len;
+  TokenKind kind;
+
+  // The length is taken from the string literal, so it can't disagree
+  // with the text
+  template<unsigned N>
+  constexpr Keyword(const char (&text_)[N], TokenKind kind_)
+    : text(text_), len(N - 1), kind(kind_) { }
+};
+
+// All keywords: adding a keyword only requires adding an entry here.
+constexpr Keyword KEYWORDS[] = {
+  { "var",      TOK_VAR },
+  { "function", TOK_FUNCTION },
+  { "if",       TOK_IF },
+  { "else",     TOK_ELSE },
+  { "while",    TOK_WHILE },
+};
+
+const unsigned KEYWORD_TABLE_SIZE = 16; // must be a power of 2
+
+// Hash function used to index the keyword table.  It only looks
+// at the length and the first and last characters, so it is cheap
+// enough to compute for every identifier.
+constexpr unsigned keyword_hash(const char *s, unsigned len) {
+  return (len + (unsigned char) s[0] + 2u * (unsigned char) s[len - 1]) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+// Perfect hash table mapping keyword_hash() values to entries in KEYWORDS
+// (-1 for empty slots), built at compile time
+struct KeywordTable {
+  int slot[KEYWORD_TABLE_SIZE];
+  bool perfect;
+
+  constexpr KeywordTable() : slot(), perfect(true) {
+    for (unsigned i = 0; i < KEYWORD_TABLE_SIZE; i++) {
+      slot[i] = -1;
+    }
+    for (unsigned i = 0; i < sizeof(KEYWORDS) / sizeof(KEYWORDS[0]); i++) {
+      unsigned h = keyword_hash(KEYWORDS[i].text, KEYWORDS[i].len);
+      if (slot[h] >= 0) {
+        perfect = false;
+      }
+      slot[h] = int(i);
+    }
+  }
+};
+
+constexpr KeywordTable KEYWORD_TABLE;
+static_assert(KEYWORD_TABLE.perfect,
+              "keywords collide in KEYWORD_TABLE: adjust keyword_hash() or KEYWORD_TABLE_SIZE");
+
+// Determine the token kind of an identifier-like lexeme:
+// either the keyword's kind, or TOK_IDENTIFIER.
+TokenKind lookup_keyword(const char *s, unsigned len) {
+  int i = KEYWORD_TABLE.slot[keyword_hash(s, len)];
+  if (i < 0) {
+    return TOK_IDENTIFIER;
+  }
+  const Keyword &candidate = KEYWORDS[i];
+  if (candidate.len == len && memcmp(candidate.text, s, len) == 0) {
+    return candidate.kind;
+  }
+  return TOK_IDENTIFIER;
+}
+
+}
+
 ////////////////////////////////////////////////////////////////////////
 // Lexer implementation
 ////////////////////////////////////////////////////////////////////////
 
 Lexer::Lexer(FILE *in, const std::string &filename)
   : m_in(in)
-  , m_filename(filename)
-  , m_line(1)
-  , m_col(1)
-  , m_eof(false) {
+  , m_file_id(SourceFileTable::add(std::unique_ptr<SourceBuffer>(new SourceBuffer(in, filename))))
+  , m_src(&SourceFileTable::get(m_file_id))
+  , m_scan(&LexScan::get())
+  , m_pos(m_src->begin())
+  , m_end(m_src->end())
+  , m_eof(false)
+  , m_pretoken_pos(0)
+  , m_local_syms(nullptr) {
+}
+
+Lexer::Lexer(unsigned file_id, unsigned begin_offset, unsigned end_offset)
+  : m_in(nullptr)
+  , m_file_id(file_id)
+  , m_src(&SourceFileTable::get(file_id))
+  , m_scan(&LexScan::get())
+  , m_pos(m_src->begin() + begin_offset)
+  , m_end(m_src->begin() + end_offset)
+  , m_eof(false)
+  , m_pretoken_pos(0)
+  , m_local_syms(nullptr) {
+}
+
+Lexer::Lexer(const Lexer &parent, const char *begin, const char *end, LocalSymbolTable *local_syms)
+  : m_in(nullptr)
+  , m_file_id(parent.m_file_id)
+  , m_src(parent.m_src)
+  , m_scan(parent.m_scan)
+  , m_pos(begin)
+  , m_end(end)
+  , m_eof(false)
+  , m_pretoken_pos(0)
+  , m_local_syms(local_syms) {
 }
 
 Lexer::~Lexer() {
-  // delete any cached lookahead tokens
-  for (auto i = m_lookahead.begin(); i != m_lookahead.end(); ++i) {
-    delete *i;
+  if (m_in != nullptr) {
+    fclose(m_in);
   }
-  fclose(m_in);
 }
 
-Node *Lexer::next() {
+Token Lexer::next() {
   fill(1);
   if (m_lookahead.empty()) {
     SyntaxError::raise(get_current_loc(), "Unexpected end of input");
   }
-  Node *tok = m_lookahead.front();
-  m_lookahead.pop_front();
-  return tok;
+  return m_lookahead.pop_front();
 }
 
-Node *Lexer::peek(int how_many) {
+const Token *Lexer::peek(int how_many) {
   // try to get as many lookahead tokens as required
   fill(how_many);
 
@@ -48,237 +151,278 @@ Node *Lexer::peek(int how_many) {
     return nullptr;
   }
 
-  // return the pointer to the Node representing the token
-  return m_lookahead.at(how_many - 1);
+  return &m_lookahead[how_many - 1];
 }
 
 Location Lexer::get_current_loc() const {
-  return Location(m_filename, m_line, m_col);
+  return Location(m_file_id, unsigned(m_pos - m_src->begin()));
+}
+
+unsigned Lexer::skip_block() {
+  assert(m_lookahead.empty());
+  int depth = 1;
+
+  // braces that were already tokenized by tokenize_parallel()
+  while (m_pretoken_pos < m_pretokens.size()) {
+    const Token &tok = m_pretokens[m_pretoken_pos];
+    if (tok.kind == TOK_LBRACE) {
+      depth++;
+    } else if (tok.kind == TOK_RBRACE && --depth == 0) {
+      return tok.offset;
+    }
+    m_pretoken_pos++;
+  }
+
+  for (; m_pos < m_end; ++m_pos) {
+    if (*m_pos == '{') {
+      depth++;
+    } else if (*m_pos == '}' && --depth == 0) {
+      break;
+    }
+  }
+  return unsigned(m_pos - m_src->begin());
 }
 
 // Read the next character of input, returning -1 (and setting m_eof to true)
 // if the end of input has been reached.
 int Lexer::read() {
-  if (m_eof) {
-    return -1;
-  }
-  int c = fgetc(m_in);
-  if (c < 0) {
+  if (m_pos == m_end) {
     m_eof = true;
-  } else if (c == '\n') {
-    m_col = 1;
-    m_line++;
-  } else {
-    m_col++;
+    return -1;
   }
-  return c;
+  return (unsigned char) *m_pos++;
 }
 
-// "Unread" a character.  Useful for when reading a character indicates
-// that the current token has ended and the next one has begun.
-void Lexer::unread(int c) {
-  ungetc(c, m_in);
-  if (c == '\n') {
-    m_line--;
-    m_col = 99;
-  } else {
-    m_col--;
-  }
+// Skip a run of whitespace.  Lines don't need to be counted:
+// Locations are computed from offsets when they're needed.
+void Lexer::skip_whitespace() {
+  m_pos = m_scan->skip_space(m_pos, m_end);
 }
 
 void Lexer::fill(int how_many) {
-  assert(how_many > 0);
+  assert(how_many > 0 && how_many <= MAX_LOOKAHEAD);
   while (!m_eof && int(m_lookahead.size()) < how_many) {
-    Node *tok = read_token();
-    if (tok != nullptr) {
-      m_lookahead.push_back(tok);
+    if (m_pretoken_pos < m_pretokens.size()) {
+      m_lookahead.push_back(m_pretokens[m_pretoken_pos++]);
+    } else if (read_token(m_lookahead.back_slot())) {
+      m_lookahead.push_back_slot();
     }
   }
 }
 
-Node *Lexer::read_token() {
-  int c, line = -1, col = -1;
+// Read one token into tok.  Returns false if the end of input
+// was reached before a token could be read.
+bool Lexer::read_token(Token &tok) {
+  skip_whitespace();
 
-  // Skip whitespace characters until a non-whitespace character is read
-  for (;;) {
-    line = m_line;
-    col = m_col;
-    c = read();
-    if (c < 0 || !isspace(c)) {
-      break;
-    }
-  }
+  int c = read();
 
   if (c < 0) {
     // Reached end of file
-    return nullptr;
+    return false;
   }
 
-  std::string lexeme;
-  lexeme.push_back(char(c));
+  // the lexeme starts at the character just read
+  const char *start = m_pos - 1;
 
+  TokenKind kind;
   if (isalpha(c)) {
     // Handle identifiers and keywords
-    
-    return handle_identifier_or_keyword(c, lexeme, line, col);
+    kind = handle_identifier_or_keyword(start);
   } else if (isdigit(c)) {
     // Handle integer literals
-    return read_continued_token(TOK_INTEGER_LITERAL, lexeme, line, col, isdigit);
+    m_pos = m_scan->skip_digits(m_pos, m_end);
+    kind = TOK_INTEGER_LITERAL;
   } else {
     // Handle possible multi-character tokens and other single characters
-    return handle_token(c, lexeme, line, col);
+    kind = handle_token(c);
   }
-}
-
-// Helper function to create a Node object to represent a token.
-Node *Lexer::token_create(enum TokenKind kind, const std::string &lexeme, int line, int col) {
-  Node *token = new Node(kind, lexeme);
-  Location source_info(m_filename, line, col);
-  token->set_loc(source_info);
-  return token;
-}
 
-// Read the continuation of a (possibly) multi-character token, such as
-// an identifier or integer literal.  pred is a pointer to a predicate
-// function to determine which characters are valid continuations.
-Node *Lexer::read_continued_token(enum TokenKind kind, const std::string &lexeme_start, int line, int col, int (*pred)(int)) {
-  std::string lexeme(lexeme_start);
-  for (;;) {
-    int c = read();
-    if (c >= 0 && pred(c)) {
-      // token has finished
-      lexeme.push_back(char(c));
-    } else {
-      if (c >= 0) {
-        unread(c);
-      }
-      return token_create(kind, lexeme, line, col);
-    }
+  tok.kind = kind;
+  tok.offset = unsigned(start - m_src->begin());
+  tok.len = unsigned(m_pos - start);
+  if (kind != TOK_IDENTIFIER) {
+    tok.sym = NO_SYMBOL;
+  } else if (m_local_syms != nullptr) {
+    tok.sym = m_local_syms->intern(start, tok.len);
+  } else {
+    tok.sym = SymbolTable::intern(start, tok.len);
   }
+  return true;
 }
 
-Node *Lexer::handle_identifier_or_keyword(int c, std::string &lexeme, int line, int col) {
-  // Read the full identifier or keyword (consisting of alphanumeric characters)
-  Node *tok = read_continued_token(TOK_IDENTIFIER, lexeme, line, col, isalnum);
-
-  // Check if "var"
-  if (tok->get_str() == "var") {
-    Node *var_tok = token_create(TOK_VAR, tok->get_str(), line, col);  // Create TOK_VAR token
-    delete tok;  
-    return var_tok;  
-  } else if (tok->get_str() == "function") {
-    Node *var_tok = token_create(TOK_FUNCTION, tok->get_str(), line, col);  // Create TOK_FUNCTION token
-    delete tok; 
-    return var_tok; 
-  } else if (tok->get_str() == "if") {
-    Node *var_tok = token_create(TOK_IF, tok->get_str(), line, col);  // Create TOK_IF token
-    delete tok;  
-    return var_tok; 
-  } else if (tok->get_str() == "else") {
-    Node *var_tok = token_create(TOK_ELSE, tok->get_str(), line, col);  // Create TOK_ELSE token
-    delete tok;  
-    return var_tok; 
-  } else if (tok->get_str() == "while") {
-    Node *var_tok = token_create(TOK_WHILE, tok->get_str(), line, col);  // Create TOK_WHILE token
-    delete tok;  
-    return var_tok; 
-  }
+TokenKind Lexer::handle_identifier_or_keyword(const char *start) {
+  // Read the full identifier or keyword (consisting of alphanumeric characters).
+  m_pos = m_scan->skip_alnum(m_pos, m_end);
 
-  // Otherwise, just return the token as an identifier
-  return tok;
+  return lookup_keyword(start, unsigned(m_pos - start));
 }
 
-
-Node *Lexer::handle_token(int c, std::string &lexeme, int line, int col) {
+TokenKind Lexer::handle_token(int c) {
   switch (c) {
     case '+':
-      return token_create(TOK_PLUS, lexeme, line, col);
+      return TOK_PLUS;
     case '-':
-      return token_create(TOK_MINUS, lexeme, line, col);
+      return TOK_MINUS;
     case '*':
-      return token_create(TOK_TIMES, lexeme, line, col);
+      return TOK_TIMES;
     case '/':
-      return token_create(TOK_DIVIDE, lexeme, line, col);
+      return TOK_DIVIDE;
     case '(':
-      return token_create(TOK_LPAREN, lexeme, line, col);
+      return TOK_LPAREN;
     case ')':
-      return token_create(TOK_RPAREN, lexeme, line, col);
+      return TOK_RPAREN;
     case ';':
-      return token_create(TOK_SEMICOLON, lexeme, line, col);
-    case '&': {
-      Node *token = check_and_create_double_char_token('&', TOK_DOUBLE_AMPERSAND, lexeme, line, col);
-      if (token) return token;
-      SyntaxError::raise(get_current_loc(), "Unexpected character '&' (expected '&&')");
-      return nullptr;
-    }
-    case '|': {
-      Node *token = check_and_create_double_char_token('|', TOK_DOUBLE_PIPE, lexeme, line, col);
-      if (token) return token;
-      SyntaxError::raise(get_current_loc(), "Unexpected character '|' (expected '||')");
-      return nullptr;
-    }
-    case '=': {
-      int next_char = read();
-      if (next_char == '=') {
-        lexeme.push_back(char(next_char));
-        return token_create(TOK_DOUBLE_EQUAL, lexeme, line, col);
-      } else {
-        unread(next_char);
-        return token_create(TOK_EQUAL, lexeme, line, col);
+      return TOK_SEMICOLON;
+    case '&':
+      if (!check_double_char('&')) {
+        SyntaxError::raise(get_current_loc(), "Unexpected character '&' (expected '&&')");
       }
-    }
-    case '<': {
-      int next_char = read();
-      if (next_char == '=') {
-        lexeme.push_back(char(next_char));
-        return token_create(TOK_LESS_EQUAL, lexeme, line, col);
-      } else {
-        unread(next_char);
-        return token_create(TOK_LESS, lexeme, line, col);
-      }
-    }
-    case '>': {
-      int next_char = read();
-      if (next_char == '=') {
-        lexeme.push_back(char(next_char));
-        return token_create(TOK_GREATER_EQUAL, lexeme, line, col);
-      } else {
-        unread(next_char);
-        return token_create(TOK_GREATER, lexeme, line, col);
+      return TOK_DOUBLE_AMPERSAND;
+    case '|':
+      if (!check_double_char('|')) {
+        SyntaxError::raise(get_current_loc(), "Unexpected character '|' (expected '||')");
       }
-    }
-    case '!': {
-      int next_char = read();
-      if (next_char == '=') {
-        lexeme.push_back(char(next_char));
-        return token_create(TOK_NOT_EQUAL, lexeme, line, col);
-      } else {
-        unread(next_char);
+      return TOK_DOUBLE_PIPE;
+    case '=':
+      return check_double_char('=') ? TOK_DOUBLE_EQUAL : TOK_EQUAL;
+    case '<':
+      return check_double_char('=') ? TOK_LESS_EQUAL : TOK_LESS;
+    case '>':
+      return check_double_char('=') ? TOK_GREATER_EQUAL : TOK_GREATER;
+    case '!':
+      if (!check_double_char('=')) {
         SyntaxError::raise(get_current_loc(), "Unexpected character '!' (expected '!=')");
-        return nullptr;
       }
-    }
+      return TOK_NOT_EQUAL;
     // Grouping/sequencing tokens
     case '{':
-      return token_create(TOK_LBRACE, lexeme, line, col);
+      return TOK_LBRACE;
     case '}':
-      return token_create(TOK_RBRACE, lexeme, line, col);
+      return TOK_RBRACE;
     case ',':
-      return token_create(TOK_COMMA, lexeme, line, col);
+      return TOK_COMMA;
     default:
       SyntaxError::raise(get_current_loc(), "Unrecognized character '%c'", c);
-      return nullptr;
   }
 }
 
-Node *Lexer::check_and_create_double_char_token(char expected_next, TokenKind double_kind, std::string &lexeme, int line, int col) {
-  int next_char = read();
-  if (next_char == expected_next) {
-    lexeme.push_back(char(next_char));
-    return token_create(double_kind, lexeme, line, col);
-  } else {
-    unread(next_char);
-    // Return nullptr when the double-character token is not formed.
-    return nullptr;
+// Consume the next character if it is the expected second character
+// of a two-character token.  Returns false (consuming nothing) otherwise.
+bool Lexer::check_double_char(char expected_next) {
+  if (peek_char() == expected_next) {
+    read();
+    return true;
+  }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Parallel tokenization
+////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Chunks smaller than this aren't worth a task of their own
+const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+// Use several chunks per thread, so that threads which finish
+// early can pick up more work
+const unsigned CHUNKS_PER_THREAD = 4;
+
+}
+
+// A range of the input tokenized by one task
+struct Lexer::Chunk {
+  const char *begin, *end;
+  std::vector<Token> tokens;
+  LocalSymbolTable syms;      // local ids for the tokens' sym fields
+  bool failed;                // true if a lexical error was found
+};
+
+void Lexer::tokenize_chunk(Chunk &chunk) const {
+  Lexer lexer(*this, chunk.begin, chunk.end, &chunk.syms);
+  try {
+    Token tok;
+    while (lexer.read_token(tok)) {
+      chunk.tokens.push_back(tok);
+    }
+  } catch (SyntaxError &ex) {
+    // The chunk will be tokenized again sequentially,
+    // so that the error is reported at the right time
+    chunk.failed = true;
+  }
+}
+
+void Lexer::tokenize_parallel(unsigned num_threads) {
+  assert(m_lookahead.empty() && m_pretokens.empty());
+
+  // Choose chunk boundaries.  Each chunk after the first
+  // starts with a whitespace character.
+  size_t remaining = size_t(m_end - m_pos);
+  size_t num_chunks = std::min(size_t(num_threads) * CHUNKS_PER_THREAD, remaining / MIN_CHUNK_SIZE);
+  if (num_threads < 2 || num_chunks < 2) {
+    return; // not worth it: tokenize sequentially
+  }
+  std::vector<const char *> bounds;
+  bounds.push_back(m_pos);
+  for (size_t i = 1; i < num_chunks; i++) {
+    const char *p = std::max(m_pos + remaining / num_chunks * i, bounds.back() + 1);
+    while (p < m_end && !isspace((unsigned char) *p)) {
+      ++p;
+    }
+    if (p >= m_end) {
+      break;
+    }
+    bounds.push_back(p);
+  }
+  bounds.push_back(m_end);
+
+  // Tokenize the chunks
+  std::vector<Chunk> chunks(bounds.size() - 1);
+  {
+    ThreadPool pool(num_threads);
+    for (size_t i = 0; i < chunks.size(); i++) {
+      Chunk &chunk = chunks[i];
+      chunk.begin = bounds[i];
+      chunk.end = bounds[i + 1];
+      chunk.failed = false;
+      pool.submit([this, &chunk] { tokenize_chunk(chunk); });
+    }
+    pool.wait();
   }
-}
\ No newline at end of file
+
+  // Stitch the chunks' tokens together, translating local symbol
+  // ids into Symbols
+  size_t total = 0;
+  for (auto i = chunks.begin(); i != chunks.end(); ++i) {
+    total += i->tokens.size();
+  }
+  m_pretokens.reserve(total);
+
+  for (auto i = chunks.begin(); i != chunks.end(); ++i) {
+    Chunk &chunk = *i;
+    if (chunk.failed) {
+      // resume sequential tokenization at the beginning of this chunk
+      m_pos = chunk.begin;
+      return;
+    }
+
+    std::vector<Symbol> global_syms(chunk.syms.get_num_symbols());
+    for (unsigned j = 0; j < chunk.syms.get_num_symbols(); j++) {
+      std::string_view name = chunk.syms.get_name(j);
+      global_syms[j] = SymbolTable::intern(name.data(), name.size());
+    }
+
+    for (auto j = chunk.tokens.begin(); j != chunk.tokens.end(); ++j) {
+      Token tok = *j;
+      if (tok.sym != NO_SYMBOL) {
+        tok.sym = global_syms[tok.sym];
+      }
+      m_pretokens.push_back(tok);
+    }
+  }
+
+  // all of the input has been tokenized
+  m_pos = m_end;
+}
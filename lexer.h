@@ -1,49 +1,122 @@
 #ifndef LEXER_H
 #define LEXER_H
 
-#include <deque>
 #include <cstdio>
+#include <string_view>
+#include <vector>
 #include "token.h"
-#include "node.h"
+#include "location.h"
+#include "source_buffer.h"
+#include "lexscan.h"
+#include "ring_buffer.h"
 
 class Lexer {
+public:
+  // Maximum number of tokens of lookahead: the grammar never
+  // needs more than two (see Parser2::parse_A())
+  static const int MAX_LOOKAHEAD = 2;
+
 private:
+  struct Chunk;
+
   FILE *m_in;
-  std::deque<Node *> m_lookahead;
-  std::string m_filename;
-  int m_line, m_col;
+  unsigned m_file_id;         // id of the input in the SourceFileTable
+  const SourceBuffer *m_src;
+  const LexScan *m_scan;      // character-class scanning routines
+  RingBuffer<Token, MAX_LOOKAHEAD> m_lookahead;
+  const char *m_pos, *m_end;  // scan position and end of the source text
   bool m_eof;
 
+  // tokens read in advance by tokenize_parallel()
+  std::vector<Token> m_pretokens;
+  size_t m_pretoken_pos;
+
+  // if non-null, identifiers are interned here rather than
+  // in the SymbolTable (see tokenize_parallel())
+  LocalSymbolTable *m_local_syms;
+
 public:
   Lexer(FILE *in, const std::string &filename);
+
+  // Tokenize the part of a file already in the SourceFileTable
+  // between the given offsets.
+  Lexer(unsigned file_id, unsigned begin_offset, unsigned end_offset);
+
   ~Lexer();
 
   // Consume the next token.
   // Throws SyntaxError if the input ends before
   // one token can be read.
-  Node *next();
+  Token next();
 
   // Look ahead and return a pointer to a future token
   // without consuming it. The how_far parameter indicates
   // how many tokens to look ahead (1 means return the
   // next token, 2 means the token after the next token,
-  // etc.)
-  Node *peek(int how_far = 1);
+  // etc.)  Returns nullptr if the input ends first.
+  // The returned pointer is only valid until the next
+  // call to next().  how_far must not exceed MAX_LOOKAHEAD;
+  // use the template version to check this at compile time.
+  const Token *peek(int how_far = 1);
+
+  template<int HowFar>
+  const Token *peek() {
+    static_assert(HowFar >= 1 && HowFar <= MAX_LOOKAHEAD, "lookahead exceeds Lexer::MAX_LOOKAHEAD");
+    return peek(HowFar);
+  }
+
+  // Get the text of a token's lexeme.  The source text is owned
+  // by the SourceFileTable, so lexemes remain valid after the
+  // Lexer is destroyed.
+  const char *get_text(const Token &tok) const { return m_src->begin() + tok.offset; }
+  std::string_view get_lexeme(const Token &tok) const { return std::string_view(get_text(tok), tok.len); }
+
+  // Get the source location of a token.
+  Location get_loc(const Token &tok) const { return Location(m_file_id, tok.offset); }
 
   Location get_current_loc() const;
 
+  // Get the id of the input in the SourceFileTable.
+  unsigned get_file_id() const { return m_file_id; }
+
+  // Tokenize all of the remaining input using the given number of
+  // threads.  The input is split into chunks at whitespace (which can't
+  // be part of a token), and the chunks are tokenized concurrently.
+  // next() and peek() then return the combined token stream, so the
+  // result is the same as tokenizing sequentially.  A lexical error
+  // is reported when the parser reaches it, just as it would be
+  // without this call.  Must be called before the first token is read.
+  void tokenize_parallel(unsigned num_threads);
+
+  // Skip the contents of a block whose opening '{' was the last token
+  // consumed, by matching braces without tokenizing the text in between
+  // (which is possible because braces can't appear in any other token).
+  // Returns the offset of the matching '}', which will be the next token,
+  // or the offset of the end of input if there is no matching '}'.
+  // There must be no tokens of lookahead when this is called.
+  unsigned skip_block();
+
 private:
+  // constructor for a Lexer which tokenizes one chunk of
+  // the parent Lexer's input
+  Lexer(const Lexer &parent, const char *begin, const char *end, LocalSymbolTable *local_syms);
+
+  // value semantics prohibited
+  Lexer(const Lexer &);
+  Lexer &operator=(const Lexer &);
+
+  void tokenize_chunk(Chunk &chunk) const;
+
   int read();
-  void unread(int c);
+  void skip_whitespace();
+  int peek_char() const { return m_pos < m_end ? (unsigned char) *m_pos : -1; }
   void fill(int how_many);
-  Node *read_token();
-  Node *token_create(enum TokenKind kind, const std::string &lexeme, int line, int col);
-  Node *read_continued_token(enum TokenKind kind, const std::string &lexeme_start, int line, int col, int (*pred)(int));
+  bool read_token(Token &tok);
 
   // Helper function declarations
-  Node *handle_identifier_or_keyword(int c, std::string &lexeme, int line, int col);
-  Node *handle_token(int c, std::string &lexeme, int line, int col);
-  Node *check_and_create_double_char_token(char expected_next, TokenKind double_kind, std::string &lexeme, int line, int col);
+  TokenKind handle_identifier_or_keyword(const char *start);
+  TokenKind handle_token(int c);
+  bool check_double_char(char expected_next);
 };
 
 #endif // LEXER_H
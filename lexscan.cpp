@@ -0,0 +1,214 @@
+#include <cstdlib>
+#include <cstring>
+#include "exceptions.h"
+#include "lexscan.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#  define LEXSCAN_X86 1
+#  include <immintrin.h>
+#endif
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////
+// Scalar implementation
+////////////////////////////////////////////////////////////////////////
+
+inline bool is_space(unsigned char c) {
+  return c == ' ' || unsigned(c - '\t') <= unsigned('\r' - '\t');
+}
+
+inline bool is_digit(unsigned char c) {
+  return unsigned(c - '0') <= 9u;
+}
+
+inline bool is_alnum(unsigned char c) {
+  return is_digit(c) || unsigned((c | 0x20) - 'a') <= 25u;
+}
+
+const char *scalar_skip_space(const char *p, const char *end) {
+  while (p < end && is_space(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+const char *scalar_skip_alnum(const char *p, const char *end) {
+  while (p < end && is_alnum(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+const char *scalar_skip_digits(const char *p, const char *end) {
+  while (p < end && is_digit(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+#ifdef LEXSCAN_X86
+
+////////////////////////////////////////////////////////////////////////
+// SSE2 implementation (16 characters per step)
+////////////////////////////////////////////////////////////////////////
+
+// Each classifier returns a vector with 0xFF in the lanes whose
+// characters are in the class.  Unsigned range checks x-lo <= hi-lo
+// are done by comparing against the saturated minimum.
+
+inline __m128i sse2_in_range(__m128i v, char lo, char hi) {
+  __m128i t = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(char(hi - lo))), t);
+}
+
+inline __m128i sse2_space(__m128i v) {
+  return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), sse2_in_range(v, '\t', '\r'));
+}
+
+inline __m128i sse2_digit(__m128i v) {
+  return sse2_in_range(v, '0', '9');
+}
+
+inline __m128i sse2_alnum(__m128i v) {
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  return _mm_or_si128(sse2_digit(v), sse2_in_range(lower, 'a', 'z'));
+}
+
+// Scan 16 characters at a time while the whole block is in the class,
+// then find the first character not in the class.  Short runs
+// (the common case) are handled by the scalar check up front.
+template<__m128i (*Classify)(__m128i), bool (*InClass)(unsigned char)>
+const char *sse2_skip(const char *p, const char *end) {
+  if (p < end && !InClass(*p)) {
+    return p;
+  }
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    unsigned mask = unsigned(_mm_movemask_epi8(Classify(v))) ^ 0xFFFFu;
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+  while (p < end && InClass(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+////////////////////////////////////////////////////////////////////////
+// AVX2 implementation (32 characters per step)
+////////////////////////////////////////////////////////////////////////
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET inline __m256i avx2_in_range(__m256i v, char lo, char hi) {
+  __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(char(hi - lo))), t);
+}
+
+AVX2_TARGET inline __m256i avx2_space(__m256i v) {
+  return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), avx2_in_range(v, '\t', '\r'));
+}
+
+AVX2_TARGET inline __m256i avx2_digit(__m256i v) {
+  return avx2_in_range(v, '0', '9');
+}
+
+AVX2_TARGET inline __m256i avx2_alnum(__m256i v) {
+  __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  return _mm256_or_si256(avx2_digit(v), avx2_in_range(lower, 'a', 'z'));
+}
+
+template<__m256i (*Classify)(__m256i), bool (*InClass)(unsigned char)>
+AVX2_TARGET const char *avx2_skip(const char *p, const char *end) {
+  if (p < end && !InClass(*p)) {
+    return p;
+  }
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    unsigned mask = ~unsigned(_mm256_movemask_epi8(Classify(v)));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+  while (p < end && InClass(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+#endif // LEXSCAN_X86
+
+const LexScan SCALAR = {
+  "scalar", scalar_skip_space, scalar_skip_alnum, scalar_skip_digits
+};
+
+#ifdef LEXSCAN_X86
+const LexScan SSE2 = {
+  "sse2",
+  sse2_skip<sse2_space, is_space>,
+  sse2_skip<sse2_alnum, is_alnum>,
+  sse2_skip<sse2_digit, is_digit>,
+};
+
+const LexScan AVX2 = {
+  "avx2",
+  avx2_skip<avx2_space, is_space>,
+  avx2_skip<avx2_alnum, is_alnum>,
+  avx2_skip<avx2_digit, is_digit>,
+};
+#endif
+
+// Implementations in order of preference
+const LexScan *const IMPLS[] = {
+#ifdef LEXSCAN_X86
+  &AVX2,
+  &SSE2,
+#endif
+  &SCALAR,
+};
+
+bool is_supported(const LexScan *impl) {
+#ifdef LEXSCAN_X86
+  if (impl == &AVX2) {
+    return __builtin_cpu_supports("avx2");
+  }
+#endif
+  return true;
+}
+
+const LexScan *choose() {
+  const char *forced = getenv("MINILANG_SCAN");
+  if (forced != nullptr && *forced != '\0') {
+    const LexScan *impl = LexScan::find(forced);
+    if (impl == nullptr) {
+      RuntimeError::raise("Unknown or unsupported MINILANG_SCAN implementation '%s'", forced);
+    }
+    return impl;
+  }
+  for (const LexScan *impl : IMPLS) {
+    if (is_supported(impl)) {
+      return impl;
+    }
+  }
+  return &SCALAR;
+}
+
+}
+
+const LexScan &LexScan::get() {
+  static const LexScan *impl = choose();
+  return *impl;
+}
+
+const LexScan *LexScan::find(const char *name) {
+  for (const LexScan *impl : IMPLS) {
+    if (strcmp(impl->name, name) == 0) {
+      return is_supported(impl) ? impl : nullptr;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,34 @@
+#ifndef LEXSCAN_H
+#define LEXSCAN_H
+
+// Character-class scanning routines used by the Lexer to find the
+// end of whitespace runs, identifiers, and integer literals.
+// Each routine returns a pointer to the first character in [p, end)
+// which is *not* in the class.
+//
+// There are several implementations: a portable scalar version,
+// and (on x86-64) SSE2 and AVX2 versions which classify 16 or 32
+// characters per step.  The best one supported by the CPU is chosen
+// at runtime.  Setting the MINILANG_SCAN environment variable to
+// "scalar", "sse2", or "avx2" overrides the choice.
+//
+// Character classes are those of isspace() and isalnum() in the
+// "C" locale.
+
+struct LexScan {
+  typedef const char *(*ScanFn)(const char *p, const char *end);
+
+  const char *name;
+  ScanFn skip_space;   // ' ', '\t', '\n', '\v', '\f', '\r'
+  ScanFn skip_alnum;   // [A-Za-z0-9]
+  ScanFn skip_digits;  // [0-9]
+
+  // Get the implementation to use (chosen on the first call).
+  static const LexScan &get();
+
+  // Get an implementation by name, or nullptr if the name is unknown
+  // or the CPU doesn't support it.
+  static const LexScan *find(const char *name);
+};
+
+#endif // LEXSCAN_H
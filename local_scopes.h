@@ -0,0 +1,80 @@
+#ifndef LOCAL_SCOPES_H
+#define LOCAL_SCOPES_H
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+// The numbering of a call's local variables, which is shared by the
+// compilers (BytecodeCompiler, RegisterCompiler and ClosureCompiler).
+// A call's scopes (the scope of its parameters, and those of its
+// blocks which define variables) are kept as local variables, each
+// scope's variables numbered after those of the scope enclosing it.
+// A lexical address (see NodeBase::set_address()) whose depth reaches
+// past the call's outermost scope refers to a global variable.
+class LocalScopes {
+private:
+  struct Scope {
+    unsigned base;      // local variable number of the scope's slot 0
+    unsigned size;      // variables defined by the scope
+    unsigned num_vars;  // variables defined so far
+  };
+
+  std::vector<Scope> m_scopes;
+  unsigned m_num_locals;  // local variables used by the scopes so far
+
+public:
+  LocalScopes() : m_num_locals(0) { }
+
+  // Start numbering the local variables of another call.
+  void clear() {
+    m_scopes.clear();
+    m_num_locals = 0;
+  }
+
+  // True if there are no local scopes, so a variable defined now is global.
+  bool empty() const { return m_scopes.empty(); }
+
+  // Enter a scope with the given number of variables, of which the
+  // first num_defined (a call's parameters) are already defined.
+  // Its variables follow those of the enclosing scope, or start at
+  // base if it's given.
+  void push(unsigned size, unsigned num_defined = 0) {
+    push_at(get_end(), size, num_defined);
+  }
+  void push_at(unsigned base, unsigned size, unsigned num_defined = 0) {
+    m_scopes.push_back({ base, size, num_defined });
+    m_num_locals = std::max(m_num_locals, base + size);
+  }
+  void pop() { m_scopes.pop_back(); }
+
+  // The local variable number following those of the innermost scope.
+  unsigned get_end() const {
+    return m_scopes.empty() ? 0 : m_scopes.back().base + m_scopes.back().size;
+  }
+
+  // The number of local variables used by the scopes entered since
+  // clear() was called.
+  unsigned get_num_locals() const { return m_num_locals; }
+
+  // Define the next variable of the innermost scope, and get its
+  // local variable number.
+  unsigned define() {
+    Scope &scope = m_scopes.back();
+    assert(scope.num_vars < scope.size);
+    return scope.base + scope.num_vars++;
+  }
+
+  // The local variable number of a (local) variable with the given
+  // lexical address, and the depth in the global environment of a
+  // variable which isn't local.
+  bool is_local(unsigned depth) const { return depth < m_scopes.size(); }
+  unsigned get_local(unsigned depth, unsigned slot) const {
+    return m_scopes[m_scopes.size() - 1 - depth].base + slot;
+  }
+  unsigned get_global_depth(unsigned depth) const {
+    return depth - unsigned(m_scopes.size());
+  }
+};
+
+#endif // LOCAL_SCOPES_H
@@ -18,34 +18,40 @@
 // ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 // OTHER DEALINGS IN THE SOFTWARE.
 
+#include "source_buffer.h"
 #include "location.h"
 
 Location::Location()
-  : m_srcfile("<unknown>")
-  , m_line(-1)
-  , m_col(-1) {
+  : m_file_id(NO_FILE)
+  , m_offset(0) {
 }
 
-Location::Location(const std::string &srcfile, int line, int col)
-  : m_srcfile(srcfile)
-  , m_line(line)
-  , m_col(col) {
+Location::Location(unsigned file_id, unsigned offset)
+  : m_file_id(file_id)
+  , m_offset(offset) {
 }
 
-Location::Location(const Location &other)
-  : m_srcfile(other.m_srcfile)
-  , m_line(other.m_line)
-  , m_col(other.m_col) {
+std::string Location::get_srcfile() const {
+  if (!is_valid()) {
+    return "<unknown>";
+  }
+  return SourceFileTable::get(m_file_id).get_filename();
 }
 
-Location::~Location() {
+int Location::get_line() const {
+  if (!is_valid()) {
+    return -1;
+  }
+  int line, col;
+  SourceFileTable::get(m_file_id).get_line_col(m_offset, line, col);
+  return line;
 }
 
-Location &Location::operator=(const Location &rhs) {
-  if (this != &rhs) {
-    m_srcfile = rhs.m_srcfile;
-    m_line = rhs.m_line;
-    m_col = rhs.m_col;
+int Location::get_col() const {
+  if (!is_valid()) {
+    return -1;
   }
-  return *this;
+  int line, col;
+  SourceFileTable::get(m_file_id).get_line_col(m_offset, line, col);
+  return col;
 }
@@ -23,28 +23,29 @@
 
 #include <string>
 
+// A Location is a compact source position: the id of a file in the
+// SourceFileTable and a byte offset within it.  The line and column
+// are only computed (from the file's text) when they are requested,
+// which normally only happens when an error is reported.
 class Location {
 private:
-  std::string m_srcfile;
-  int m_line, m_col;
+  unsigned m_file_id;
+  unsigned m_offset;
+
+  static const unsigned NO_FILE = ~0u;
 
 public:
   Location();
-  Location(const std::string &srcfile, int line, int col);
-  Location(const Location &other);
-  ~Location();
-
-  Location &operator=(const Location &rhs);
-
-  bool is_valid() const { return m_line > 0; }
+  Location(unsigned file_id, unsigned offset);
 
-  std::string get_srcfile() const { return m_srcfile; }
-  int get_line() const { return m_line; }
-  int get_col() const { return m_col; }
+  bool is_valid() const { return m_file_id != NO_FILE; }
 
-  void advance(int num_cols) { m_col += num_cols; }
+  unsigned get_file_id() const { return m_file_id; }
+  unsigned get_offset() const { return m_offset; }
 
-  void next_line() { m_line++; m_col = 1; }
+  std::string get_srcfile() const;
+  int get_line() const;
+  int get_col() const;
 };
 
 #endif // LOCATION_H
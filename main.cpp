@@ -1,12 +1,17 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h> // for getopt
 #include <memory>
 #include "lexer.h"
 #include "parser2.h"
 #include "ast.h"
+#include "ast_arena.h"
+#include "flat_ast.h"
 #include "exceptions.h"
 #include "treeprint.h"
 #include "interp.h"
+#include "stats.h"
+#include "ast_cache.h"
 
 enum {
   PRINT_TOKENS,
@@ -19,7 +24,17 @@ enum {
 int execute(int argc, char **argv) {
   // handle command line options
   int mode = EXECUTE, opt;
-  while ((opt = getopt(argc, argv, "lp")) != -1) {
+  int num_lexer_threads = 1;
+  bool use_parse_stack = false;
+  bool lazy_function_bodies = false;
+  bool print_stats = false;
+  bool use_ast_cache = false;
+  bool use_flat_ast = false;
+  bool use_bytecode = false;
+  bool use_registers = false;
+  bool use_closures = false;
+  int max_parse_depth = Parser2::DEFAULT_MAX_DEPTH;
+  while ((opt = getopt(argc, argv, "lpj:id:zscfbrk")) != -1) {
     switch (opt) {
     case 'l':
       mode = PRINT_TOKENS;
@@ -27,10 +42,59 @@ int execute(int argc, char **argv) {
     case 'p':
       mode = PRINT_AST;
       break;
+    case 'j':
+      // tokenize the input using this many threads
+      num_lexer_threads = atoi(optarg);
+      if (num_lexer_threads < 1) {
+        RuntimeError::raise("Invalid number of lexer threads: %s", optarg);
+      }
+      break;
+    case 'i':
+      // parse with an explicit stack, rather than recursively
+      use_parse_stack = true;
+      break;
+    case 'd':
+      // limit on nesting depth when parsing with an explicit stack
+      max_parse_depth = atoi(optarg);
+      if (max_parse_depth < 0) {
+        RuntimeError::raise("Invalid maximum nesting depth: %s", optarg);
+      }
+      break;
+    case 'z':
+      // don't parse function bodies until they are called
+      lazy_function_bodies = true;
+      break;
+    case 's':
+      // print statistics when done
+      print_stats = true;
+      break;
+    case 'c':
+      // load the AST from a cache file if possible, and save it otherwise
+      use_ast_cache = true;
+      break;
+    case 'f':
+      // print or execute a flattened copy of the AST (see FlatAST)
+      use_flat_ast = true;
+      break;
+    case 'b':
+      // execute the program by compiling it to bytecode (see VM)
+      use_bytecode = true;
+      break;
+    case 'r':
+      // execute the program by compiling it to register code (see RegisterVM)
+      use_registers = true;
+      break;
+    case 'k':
+      // execute the program by compiling it to closures (see ClosureCompiler)
+      use_closures = true;
+      break;
     default:
       RuntimeError::raise("Unknown option: %c", opt);
     }
   }
+  if (int(use_bytecode) + int(use_registers) + int(use_closures) > 1) {
+    RuntimeError::raise("only one of -b, -r, -k may be given");
+  }
 
   // determine source of input
 
@@ -51,35 +115,84 @@ int execute(int argc, char **argv) {
 
   // create the Lexer
   std::unique_ptr<Lexer> lexer(new Lexer(in, filename));
+  unsigned file_id = lexer->get_file_id();
+
+  // the arena holds the AST's nodes
+  std::unique_ptr<ASTArena> arena(new ASTArena());
+
+  // if the AST is cached, the input doesn't need to be parsed
+  Node *ast = nullptr;
+  if (use_ast_cache && mode != PRINT_TOKENS) {
+    ast = ASTCache::load(file_id, lazy_function_bodies, *arena);
+  }
+
+  if (num_lexer_threads > 1 && ast == nullptr) {
+    lexer->tokenize_parallel(unsigned(num_lexer_threads));
+  }
 
   if (mode == PRINT_TOKENS) {
     // just print the tokens
     while (lexer->peek() != nullptr) {
-      Node *tok = lexer->next();
-      int kind = tok->get_tag();
-      std::string lexeme = tok->get_str();
-      printf("%d:%s\n", kind, lexeme.c_str());
-      delete tok;
+      Token tok = lexer->next();
+      printf("%d:%.*s\n", int(tok.kind), int(tok.len), lexer->get_text(tok));
     }
   } else if (mode == PRINT_AST || mode == EXECUTE) {
-    // Create parser and parse the input
-    std::unique_ptr<Parser2> parser2(new Parser2(lexer.release()));
-    std::unique_ptr<Node> ast(parser2->parse());
+    if (ast == nullptr) {
+      // Create parser and parse the input
+      std::unique_ptr<Parser2> parser2(new Parser2(lexer.release(), arena.get()));
+      parser2->set_use_stack(use_parse_stack);
+      parser2->set_max_depth(max_parse_depth);
+      parser2->set_lazy_function_bodies(lazy_function_bodies);
+      ast = parser2->parse();
+
+      if (use_ast_cache) {
+        ASTCache::store(ast, file_id, lazy_function_bodies);
+      }
+    }
 
     if (mode == PRINT_AST) {
       // Print a text representation of the AST
       ASTTreePrint tp;
-      tp.print(ast.get());
+      if (use_flat_ast) {
+        FlatAST flat_ast(ast);
+        tp.print(flat_ast);
+      } else {
+        tp.print(ast);
+      }
     } else {
       // Execute the program: note that the Interpreter assumes responsibility
-      // for deleting the AST
-      Interpreter interp(ast.release());
+      // for deleting the arena, and with it the AST
+      Interpreter interp(ast, arena.release());
+      if (use_flat_ast) {
+        interp.flatten_ast();
+      }
       interp.analyze();
-      Value result = interp.execute();
+      if (use_closures) {
+        interp.compile_closures();
+      } else if (use_registers) {
+        interp.compile_registers();
+      } else if (use_bytecode) {
+        interp.compile_bytecode();
+      }
+      Value result;
+      try {
+        result = interp.execute();
+      } catch (BaseException &) {
+        // a run which fails still reports the statistics gathered so
+        // far, such as the operators de-specialized by a bad operand
+        if (print_stats) {
+          Stats::print(stderr);
+        }
+        throw;
+      }
       printf("Result: %s\n", result.as_str().c_str());
     }
   }
 
+  if (print_stats) {
+    Stats::print(stderr);
+  }
+
   return 0;
 }
 
@@ -18,65 +18,94 @@
 // ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 // OTHER DEALINGS IN THE SOFTWARE.
 
+#include <cassert>
+#include <cstring>
 #include "node.h"
+#include "ast_arena.h"
 
 // Private constructor, used only by other constructors
-Node::Node(int tag, const std::string &str, const std::vector<Node *> &kids)
+Node::Node(ASTArena &arena, int tag, std::string_view str, Node *const *kids, unsigned num_kids)
   : m_tag(tag)
-  , m_kids(kids)
-  , m_str(str)
-  , m_loc_was_set_explicitly(false) {
-}
-
-// Private constructor, used only by other constructors
-Node::Node(int tag, const std::string &str, const std::initializer_list<Node *> kids)
-  : m_tag(tag)
-  , m_kids(kids)
+  , m_arena(&arena)
+  , m_kids(nullptr)
+  , m_num_kids(0)
+  , m_max_kids(0)
   , m_str(str)
   , m_loc_was_set_explicitly(false) {
+  if (num_kids > 0) {
+    reserve_kids(num_kids);
+    memcpy(m_kids, kids, num_kids * sizeof(Node *));
+    m_num_kids = num_kids;
+  }
 }
 
-Node::Node(int tag)
-  : Node(tag, "", {}) {
+Node::Node(ASTArena &arena, int tag)
+  : Node(arena, tag, "", nullptr, 0) {
 }
 
-Node::Node(int tag, std::initializer_list<Node *> kids)
-  : Node(tag, "", kids) {
+Node::Node(ASTArena &arena, int tag, std::initializer_list<Node *> kids)
+  : Node(arena, tag, "", kids.begin(), unsigned(kids.size())) {
   // parent node's location defaults to first kid's location
-  if (!m_kids.empty()) {
+  if (m_num_kids > 0) {
     m_loc = m_kids[0]->get_loc();
   }
 }
 
-Node::Node(int tag, const std::vector<Node *> &kids)
-  : Node(tag, "", kids) {
+Node::Node(ASTArena &arena, int tag, const std::vector<Node *> &kids)
+  : Node(arena, tag, "", kids.data(), unsigned(kids.size())) {
   // parent node's location defaults to first kid's location
-  if (!m_kids.empty()) {
+  if (m_num_kids > 0) {
     m_loc = m_kids[0]->get_loc();
   }
 }
 
-Node::Node(int tag, const std::string &str)
-  : Node(tag, str, {}) {
+Node::Node(ASTArena &arena, int tag, std::string_view str)
+  : Node(arena, tag, str, nullptr, 0) {
 }
 
-Node::~Node() {
-  // delete child nodes
-  for (auto i = m_kids.begin(); i != m_kids.end(); ++i) {
-    delete *i;
-  }
+Node *Node::get_kid(unsigned index) const {
+  assert(index < m_num_kids);
+  return m_kids[index];
 }
 
 void Node::append_kid(Node *kid) {
-  m_kids.push_back(kid);
+  if (m_num_kids == m_max_kids) {
+    reserve_kids(m_max_kids == 0 ? 4 : m_max_kids * 2);
+  }
+  m_kids[m_num_kids++] = kid;
   // parent node's location defaults to first kid's location
   if (!m_loc.is_valid()) {
     m_loc = kid->get_loc();
   }
 }
 
+void Node::replace_with(Node *other) {
+  assert(other->m_arena == m_arena);
+
+  // the old children (and other) remain in the arena,
+  // but are no longer reachable
+  m_tag = other->m_tag;
+  m_num_kids = other->m_num_kids;
+  m_max_kids = other->m_max_kids;
+  m_kids = other->m_kids;
+  m_str = other->m_str;
+  m_loc = other->m_loc;
+  m_loc_was_set_explicitly = other->m_loc_was_set_explicitly;
+  set_symbol(other->get_symbol());
+  set_int_value(other->get_int_value());
+  set_address(other->get_depth(), other->get_slot());
+  set_num_vars(other->get_num_vars());
+  other->m_num_kids = other->m_max_kids = 0;
+  other->m_kids = nullptr;
+}
+
 void Node::prepend_kid(Node *kid) {
-  m_kids.insert(m_kids.begin(), kid);
+  if (m_num_kids == m_max_kids) {
+    reserve_kids(m_max_kids == 0 ? 4 : m_max_kids * 2);
+  }
+  memmove(m_kids + 1, m_kids, m_num_kids * sizeof(Node *));
+  m_kids[0] = kid;
+  m_num_kids++;
 
   // Here, we update the parent's location unconditionally
   // (since we generally want the parent's location to match that
@@ -86,3 +115,17 @@ void Node::prepend_kid(Node *kid) {
     m_loc = kid->get_loc();
   }
 }
+
+// Make room for at least max_kids children.  The old array
+// is left in the arena, to be freed along with everything else.
+void Node::reserve_kids(unsigned max_kids) {
+  if (max_kids <= m_max_kids) {
+    return;
+  }
+  Node **kids = static_cast<Node **>(m_arena->allocate(max_kids * sizeof(Node *), alignof(Node *)));
+  if (m_num_kids > 0) {
+    memcpy(kids, m_kids, m_num_kids * sizeof(Node *));
+  }
+  m_kids = kids;
+  m_max_kids = max_kids;
+}
@@ -23,20 +23,28 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include "location.h"
 #include "node_base.h"
 
+class ASTArena;
+
 // Tree node class, suitable for parse trees and ASTs.
 // Nodes can also be used as tokens returned by a lexer.
-// Note that parent nodes take responsibility for deleting
-// their children, so to delete an entire tree, it is
-// sufficient to delete the root.
+// Nodes are created by an ASTArena (see ASTArena::new_node()),
+// which also holds the arrays of child pointers, and are
+// all freed together when the arena is destroyed.
+// A node's string is not copied: it is normally a lexeme
+// in the source text (see SourceFileTable), and must
+// outlive the node.
 
 class Node : public NodeBase {
 private:
   int m_tag;
-  std::vector<Node *> m_kids;
-  std::string m_str;
+  ASTArena *m_arena;
+  Node **m_kids;  // allocated in m_arena
+  unsigned m_num_kids, m_max_kids;
+  std::string_view m_str;
   Location m_loc;
   bool m_loc_was_set_explicitly;
 
@@ -44,43 +52,52 @@ private:
   Node(const Node &);
   Node &operator=(const Node &);
 
-  Node(int tag, const std::string &str, const std::vector<Node *> &kids);
-  Node(int tag, const std::string &str, const std::initializer_list<Node *> kids);
+  // only ASTArena creates nodes
+  friend class ASTArena;
 
-public:
-  typedef std::vector<Node *>::const_iterator const_iterator;
+  Node(ASTArena &arena, int tag, std::string_view str, Node *const *kids, unsigned num_kids);
 
-  Node(int tag);
-  Node(int tag, std::initializer_list<Node *> kids);
-  Node(int tag, const std::vector<Node *> &kids);
-  Node(int tag, const std::string &str);
+  Node(ASTArena &arena, int tag);
+  Node(ASTArena &arena, int tag, std::initializer_list<Node *> kids);
+  Node(ASTArena &arena, int tag, const std::vector<Node *> &kids);
+  Node(ASTArena &arena, int tag, std::string_view str);
+
+public:
+  typedef Node *const *const_iterator;
 
-  virtual ~Node();
+  ASTArena &get_arena() const { return *m_arena; }
 
   int get_tag() const { return m_tag; }
   void set_tag(int tag) { m_tag = tag; }
 
-  std::string get_str() const { return m_str; }
-  void set_str(const std::string &str) { m_str = str; }
+  std::string_view get_str() const { return m_str; }
+  void set_str(std::string_view str) { m_str = str; }
 
   void append_kid(Node *kid);
   void prepend_kid(Node *kid);
-  unsigned get_num_kids() const { return unsigned(m_kids.size()); }
-  Node *get_kid(unsigned index) const { return m_kids.at(index); }
-  Node *get_last_kid() const { return m_kids.back(); }
 
-  const_iterator cbegin() const { return m_kids.cbegin(); }
-  const_iterator cend() const { return m_kids.cend(); }
+  // Replace this node's tag, string, children, location, and symbol
+  // with those of another node in the same arena, which should no
+  // longer be used.  This allows a placeholder node to be filled in
+  // without updating its parent.
+  void replace_with(Node *other);
+  unsigned get_num_kids() const { return m_num_kids; }
+  Node *get_kid(unsigned index) const;
+  Node *get_last_kid() const { return get_kid(m_num_kids - 1); }
+
+  const_iterator cbegin() const { return m_kids; }
+  const_iterator cend() const { return m_kids + m_num_kids; }
 
   void set_loc(const Location &loc) { m_loc = loc; m_loc_was_set_explicitly = true; }
   const Location &get_loc() const { return m_loc; }
+  bool has_explicit_loc() const { return m_loc_was_set_explicitly; }
 
   // do a preorder traversal of the tree, invoking specified
   // function on each node
   template<typename Fn>
   void preorder(Fn fn) {
     fn(this);
-    for (auto i = m_kids.begin(); i != m_kids.end(); ++i) {
+    for (auto i = cbegin(); i != cend(); ++i) {
       (*i)->preorder(fn);
     }
   }
@@ -88,10 +105,13 @@ public:
   // invoke a function on each child
   template<typename Fn>
   void each_child(Fn fn) const {
-    for (auto i = m_kids.begin(); i != m_kids.end(); ++i) {
+    for (auto i = cbegin(); i != cend(); ++i) {
       fn(*i);
     }
   }
+
+private:
+  void reserve_kids(unsigned max_kids);
 };
 
 #endif // NODE_H
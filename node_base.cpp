@@ -20,8 +20,10 @@
 
 #include "node_base.h"
 
-NodeBase::NodeBase() {
-}
-
-NodeBase::~NodeBase() {
+NodeBase::NodeBase()
+  : m_symbol(NO_SYMBOL)
+  , m_int_value(0)
+  , m_depth(0)
+  , m_slot(0)
+  , m_num_vars(0) {
 }
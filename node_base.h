@@ -21,13 +21,20 @@
 #ifndef NODE_BASE_H
 #define NODE_BASE_H
 
+#include "symtab.h"
+
 // The Node class will inherit from this type, so you can use it
 // to define any attributes and methods that Node objects should have
 // (constant value, results of semantic analysis, code generation info,
-// etc.)
+// etc.)  Note that Nodes are freed without being destroyed (see
+// ASTArena), so members must not require destructors.
 class NodeBase {
 private:
-  // fields could go here
+  Symbol m_symbol; // interned identifier, for AST_VARREF nodes
+  int m_int_value; // decoded value, for AST_INT_LITERAL nodes
+  unsigned m_depth; // lexical address, for AST_VARREF nodes
+  unsigned m_slot;  //   (see set_address())
+  unsigned m_num_vars; // variables defined, for AST_STATEMENT_LIST nodes
 
   // copy ctor and assignment operator not supported
   NodeBase(const NodeBase &);
@@ -35,7 +42,26 @@ private:
 
 public:
   NodeBase();
-  virtual ~NodeBase();
+
+  Symbol get_symbol() const { return m_symbol; }
+  void set_symbol(Symbol symbol) { m_symbol = symbol; }
+
+  int get_int_value() const { return m_int_value; }
+  void set_int_value(int int_value) { m_int_value = int_value; }
+
+  // The lexical address of the variable a reference refers to, which
+  // is filled in by Interpreter::analyze(): depth is the number of
+  // scopes out from the reference to the scope defining the variable,
+  // and slot is the variable's index in that scope.
+  unsigned get_depth() const { return m_depth; }
+  unsigned get_slot() const { return m_slot; }
+  void set_address(unsigned depth, unsigned slot) { m_depth = depth; m_slot = slot; }
+
+  // The number of variables a block defines, which is filled in by
+  // Interpreter::analyze().  A block which doesn't define any
+  // variables doesn't get a scope of its own.
+  unsigned get_num_vars() const { return m_num_vars; }
+  void set_num_vars(unsigned num_vars) { m_num_vars = num_vars; }
 };
 
 #endif // NODE_BASE_H
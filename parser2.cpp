@@ -1,13 +1,74 @@
 #include <cassert>
+#include <charconv>
 #include <map>
 #include <string>
-#include <memory>
+#include <vector>
 #include "token.h"
 #include "ast.h"
 #include "exceptions.h"
+#include "stats.h"
+#include "ast_arena.h"
 #include "parser2.h"
 #include <iostream>
 
+namespace {
+
+////////////////////////////////////////////////////////////////////////
+// Binary operators
+////////////////////////////////////////////////////////////////////////
+
+enum Assoc { LEFT, NONASSOC };
+
+struct BinaryOp {
+  TokenKind tok;
+  int prec;       // precedence: higher binds more tightly, 0 if not an operator
+  int ast_tag;
+  Assoc assoc;
+};
+
+// All binary operators: adding a binary operator only requires
+// adding an entry here (and evaluating its AST node).
+constexpr BinaryOp BINARY_OPS[] = {
+  { TOK_DOUBLE_PIPE,      1, AST_LOGICAL_OR,    NONASSOC },
+  { TOK_DOUBLE_AMPERSAND, 1, AST_LOGICAL_AND,   NONASSOC },
+  { TOK_LESS,             2, AST_LESS,          NONASSOC },
+  { TOK_LESS_EQUAL,       2, AST_LESS_EQUAL,    NONASSOC },
+  { TOK_GREATER,          2, AST_GREATER,       NONASSOC },
+  { TOK_GREATER_EQUAL,    2, AST_GREATER_EQUAL, NONASSOC },
+  { TOK_DOUBLE_EQUAL,     2, AST_EQUAL,         NONASSOC },
+  { TOK_NOT_EQUAL,        2, AST_NOT_EQUAL,     NONASSOC },
+  { TOK_PLUS,             3, AST_ADD,           LEFT },
+  { TOK_MINUS,            3, AST_SUB,           LEFT },
+  { TOK_TIMES,            4, AST_MULTIPLY,      LEFT },
+  { TOK_DIVIDE,           4, AST_DIVIDE,        LEFT },
+};
+
+const int MAX_PRECEDENCE = 4;
+
+const unsigned NUM_TOKEN_KINDS = TOK_COMMA + 1; // TOK_COMMA is the last TokenKind
+
+// Table mapping each TokenKind to its BinaryOp entry, built at compile time
+struct BinaryOpTable {
+  BinaryOp op[NUM_TOKEN_KINDS];
+
+  constexpr BinaryOpTable() : op() {
+    for (unsigned i = 0; i < NUM_TOKEN_KINDS; i++) {
+      op[i] = BinaryOp{ TokenKind(i), 0, 0, LEFT };
+    }
+    for (unsigned i = 0; i < sizeof(BINARY_OPS) / sizeof(BINARY_OPS[0]); i++) {
+      op[BINARY_OPS[i].tok] = BINARY_OPS[i];
+    }
+  }
+};
+
+constexpr BinaryOpTable BINARY_OP_TABLE;
+
+const BinaryOp &get_binary_op(TokenKind kind) {
+  return BINARY_OP_TABLE.op[kind];
+}
+
+}
+
 ////////////////////////////////////////////////////////////////////////
 // Parser2 implementation
 // This version of the parser builds an AST directly,
@@ -19,21 +80,23 @@
 // Unit -> Stmt
 // Unit -> Stmt Unit
 // Stmt -> E ;
-// E -> T E'
-// E' -> + T E'
-// E' -> - T E'
-// E' -> epsilon
-// T -> F T'
-// T' -> * F T'
-// T' -> / F T'
-// T' -> epsilon
+// E -> E + T
+// E -> E - T
+// E -> T
+// T -> T * F
+// T -> T / F
+// T -> F
 // F -> number
 // F -> ident
 // F -> ( E )
 
-Parser2::Parser2(Lexer *lexer_to_adopt)
+Parser2::Parser2(Lexer *lexer_to_adopt, ASTArena *arena)
   : m_lexer(lexer_to_adopt)
-  , m_next(nullptr) {
+  , m_arena(arena)
+  , m_next(nullptr)
+  , m_use_stack(false)
+  , m_max_depth(DEFAULT_MAX_DEPTH)
+  , m_lazy_bodies(false) {
 }
 
 Parser2::~Parser2() {
@@ -41,7 +104,24 @@ Parser2::~Parser2() {
 }
 
 Node *Parser2::parse() {
-  return parse_Unit();
+  return m_use_stack ? parse_with_stack() : parse_Unit();
+}
+
+void Parser2::parse_lazy_body(Node *body) {
+  assert(body->get_tag() == AST_LAZY_STATEMENT_LIST);
+  Location loc = body->get_loc();
+  unsigned begin = loc.get_offset();
+  unsigned end = begin + unsigned(body->get_str().size());
+
+  Parser2 parser(new Lexer(loc.get_file_id(), begin, end), &body->get_arena());
+  Node *slist = parser.parse_SList();
+
+  // the body's braces are balanced, so parse_SList() can't
+  // stop at a '}' before the end of the body
+  assert(parser.m_lexer->peek() == nullptr);
+
+  body->replace_with(slist);
+  Stats::lazy_bodies_parsed++;
 }
 Node *Parser2::parse_Unit() {
   // note that this function produces a "flattened" representation
@@ -50,25 +130,25 @@ Node *Parser2::parse_Unit() {
   // new production Unit -> TStmt
   // new production Unit -> TStmt Unit
 
-  std::unique_ptr<Node> unit(new Node(AST_UNIT));
+  Node *unit = m_arena->new_node(AST_UNIT);
   for (;;) {
     unit->append_kid(parse_TStmt());
     if (m_lexer->peek() == nullptr)
       break;
   }
 
-  return unit.release();
+  return unit;
 }
 
 Node *Parser2::parse_TStmt() {
   // Peek at the next token to decide what kind of statement we are parsing
-  Node *next_tok = m_lexer->peek();
+  const Token *next_tok = m_lexer->peek();
   if (next_tok == nullptr) {
     SyntaxError::raise(m_lexer->get_current_loc(), "Unexpected end of input looking for statement");
   }
 
   // Check if the next token is 'function' (indicating a function definition)
-  if (next_tok->get_tag() == TOK_FUNCTION) {
+  if (next_tok->kind == TOK_FUNCTION) {
     // TStmt → Func
     return parse_Func();  // Parse the function definition
   } else {
@@ -78,16 +158,16 @@ Node *Parser2::parse_TStmt() {
 }
 
 Node *Parser2::parse_Stmt() {
-  std::unique_ptr<Node> stmt(new Node(AST_STATEMENT));
+  Node *stmt = m_arena->new_node(AST_STATEMENT);
 
   // Peek at the next token to decide what kind of statement we are parsing
-  Node *next_tok = m_lexer->peek();
+  const Token *next_tok = m_lexer->peek();
   if (next_tok == nullptr) {
     SyntaxError::raise(m_lexer->get_current_loc(), "Unexpected end of input looking for statement");
   }
 
   // Check if the next token is 'var' (indicating a variable declaration)
-  switch(next_tok->get_tag()) {
+  switch(next_tok->kind) {
     case TOK_VAR: 
       stmt->append_kid(parse_varDec());  // parse var declaration
       break;
@@ -104,172 +184,173 @@ Node *Parser2::parse_Stmt() {
       expect_and_discard(TOK_SEMICOLON);                     // Consume the semicolon at the end of the statement
       break;
   }
-  return stmt.release();  // Return the constructed statement node
+  return stmt;  // Return the constructed statement node
 }
 
 // Parse variable decl helper
 Node *Parser2::parse_varDec() {
   // Stmt → var ident ;
-  std::unique_ptr<Node> var_decl(expect(TOK_VAR));       // Consume 'var'
-  std::unique_ptr<Node> ident(expect(TOK_IDENTIFIER));   // Consume identifier (e.g., 'a')
+  Token var_decl = expect(TOK_VAR);       // Consume 'var'
+  Token ident = expect(TOK_IDENTIFIER);   // Consume identifier (e.g., 'a')
   
   // Create an AST_VARREF node for the variable reference
-  std::unique_ptr<Node> var_ref(new Node(AST_VARREF));
-  var_ref->set_str(ident->get_str());                    // Set the identifier string
-  var_ref->set_loc(ident->get_loc());                    // Set the location info
+  Node *var_ref = token_to_node(AST_VARREF, ident);
 
   expect_and_discard(TOK_SEMICOLON);                     // Consume ';'
 
   // Create the AST_VARDEF node and append the VARREF node as a child
-  std::unique_ptr<Node> var_def_node(new Node(AST_VARDEF, {var_ref.release()}));
-  var_def_node->set_loc(var_decl->get_loc());            // Set the location to 'var'
-  return var_def_node.release();                         // Return the constructed variable declaration node
+  Node *var_def_node = m_arena->new_node(AST_VARDEF, {var_ref});
+  var_def_node->set_loc(m_lexer->get_loc(var_decl));            // Set the location to 'var'
+  return var_def_node;                         // Return the constructed variable declaration node
 }
 
 Node *Parser2::parse_If() {
   //   Stmt →       if ( A ) { SList }                     -- if stmt
   // Stmt →       if ( A ) { SList } else { SList }      -- if/else stmt 
-  std::unique_ptr<Node> if_tok(expect(TOK_IF));
+  Token if_tok = expect(TOK_IF);
   expect_and_discard(TOK_LPAREN);
-  std::unique_ptr<Node> condition(parse_A());
+  Node *condition = parse_A();
   expect_and_discard(TOK_RPAREN);
 
   expect_and_discard(TOK_LBRACE);
-  std::unique_ptr<Node> slist(parse_SList()); // parse statementlist
+  Node *slist = parse_SList(); // parse statementlist
   expect_and_discard(TOK_RBRACE);
 
   Node *else_block = nullptr;
 
   // Check else
-  Node *next_tok = m_lexer->peek();
-  if (next_tok != nullptr && next_tok->get_tag() == TOK_ELSE) {
-    std::unique_ptr<Node> else_tok(expect(TOK_ELSE));
+  const Token *next_tok = m_lexer->peek();
+  if (next_tok != nullptr && next_tok->kind == TOK_ELSE) {
+    expect_and_discard(TOK_ELSE);
     expect_and_discard(TOK_LBRACE);
-    std::unique_ptr<Node> else_block_node(parse_SList());
+    else_block = parse_SList();
     expect_and_discard(TOK_RBRACE);
-    else_block = else_block_node.release();
   }
 
   // Create AST_IF nmode
-  std::vector<Node *> children = {condition.release(), slist.release()};
+  std::vector<Node *> children = {condition, slist};
   if (else_block != nullptr) {
     children.push_back(else_block);
   }
-  std::unique_ptr<Node> if_node(new Node(AST_IF, children));
-  if_node->set_loc(if_tok->get_loc());
+  Node *if_node = m_arena->new_node(AST_IF, children);
+  if_node->set_loc(m_lexer->get_loc(if_tok));
 
-  return if_node.release();
+  return if_node;
 }
 
 Node *Parser2::parse_While() {
   // Stmt → while ( A ) { SList }
-  std::unique_ptr<Node> while_tok(expect(TOK_WHILE));
+  Token while_tok = expect(TOK_WHILE);
 
   expect_and_discard(TOK_LPAREN);
-  std::unique_ptr<Node> condition(parse_A());
+  Node *condition = parse_A();
   expect_and_discard(TOK_RPAREN);
 
   expect_and_discard(TOK_LBRACE);
-  std::unique_ptr<Node> slist(parse_SList());
+  Node *slist = parse_SList();
   expect_and_discard(TOK_RBRACE);
 
   // Create AST_WHILE node
-  std::vector<Node *> children = { condition.release(), slist.release() };
-  std::unique_ptr<Node> while_node(new Node(AST_WHILE, children));
-  while_node->set_loc(while_tok->get_loc());
+  std::vector<Node *> children = { condition, slist };
+  Node *while_node = m_arena->new_node(AST_WHILE, children);
+  while_node->set_loc(m_lexer->get_loc(while_tok));
 
-  return while_node.release();
+  return while_node;
 }
 
 Node *Parser2::parse_SList() {
-  std::unique_ptr<Node> slist (new Node(AST_STATEMENT_LIST));
+  Node *slist = m_arena->new_node(AST_STATEMENT_LIST);
   while (true) {
-    Node *next_tok = m_lexer->peek();
-    if (next_tok == nullptr || next_tok->get_tag() == TOK_RBRACE) {
+    const Token *next_tok = m_lexer->peek();
+    if (next_tok == nullptr || next_tok->kind == TOK_RBRACE) {
       break;
     }
     slist->append_kid(parse_Stmt());
   }
 
-  return slist.release();
+  return slist;
 }
 
 Node *Parser2::parse_Func() {
   // Func → function ident ( OptPList ) { SList }
-  std::unique_ptr<Node> func_tok(expect(TOK_FUNCTION));
+  Token func_tok = expect(TOK_FUNCTION);
 
-  std::unique_ptr<Node> ident(expect(TOK_IDENTIFIER));
-  Location func_loc = func_tok->get_loc();
+  Token ident = expect(TOK_IDENTIFIER);
+  Location func_loc = m_lexer->get_loc(func_tok);
 
   // create varref node
-  std::unique_ptr<Node> func_name_node(new Node(AST_VARREF));
-  func_name_node->set_str(ident->get_str());
-  func_name_node->set_loc(ident->get_loc());
+  Node *func_name_node = token_to_node(AST_VARREF, ident);
 
   expect_and_discard(TOK_LPAREN);
-  std::unique_ptr<Node> parameter_list(parse_OptPList());
+  Node *parameter_list = parse_OptPList();
   expect_and_discard(TOK_RPAREN);
 
-  expect_and_discard(TOK_LBRACE);
-  std::unique_ptr<Node> slist(parse_SList());
+  Token lbrace = expect(TOK_LBRACE);
+  Node *slist = m_lazy_bodies ? skip_function_body(lbrace) : parse_SList();
   expect_and_discard(TOK_RBRACE);
 
   // Build the list of child nodes for the FUNCTION node
   std::vector<Node *> children;
 
   // add varref as first child
-  children.push_back(func_name_node.release());
+  children.push_back(func_name_node);
 
   if (parameter_list != nullptr) {
-    children.push_back(parameter_list.release());
+    children.push_back(parameter_list);
   }
 
-  children.push_back(slist.release());
+  children.push_back(slist);
 
-  std::unique_ptr<Node> func_node(new Node(AST_FUNCTION, children));
+  Node *func_node = m_arena->new_node(AST_FUNCTION, children);
   func_node->set_loc(func_loc);
 
-  return func_node.release();
+  return func_node;
 }
   
+Node *Parser2::skip_function_body(const Token &lbrace) {
+  unsigned begin = lbrace.offset + 1;
+  unsigned end = m_lexer->skip_block();
+
+  Node *body = m_arena->new_node(AST_LAZY_STATEMENT_LIST, std::string_view(m_lexer->get_text(lbrace) + 1, end - begin));
+  body->set_loc(Location(m_lexer->get_loc(lbrace).get_file_id(), begin));
+  Stats::lazy_bodies++;
+  return body;
+}
+
 Node *Parser2::parse_OptPList() {
-  Node *next_tok = m_lexer->peek();
-  if (next_tok != nullptr && next_tok->get_tag() == TOK_IDENTIFIER) {
+  const Token *next_tok = m_lexer->peek();
+  if (next_tok != nullptr && next_tok->kind == TOK_IDENTIFIER) {
     return parse_PList();
   }
   return nullptr; // epsilon
 }
 
 Node *Parser2::parse_PList() {
-  std::unique_ptr<Node> plist(new Node(AST_PARAMETER_LIST));
+  Node *plist = m_arena->new_node(AST_PARAMETER_LIST);
 
   // parse first ident
-  std::unique_ptr<Node> ident(expect(TOK_IDENTIFIER));
-  std::unique_ptr<Node> var_ref(new Node(AST_VARREF));
-  var_ref->set_str(ident->get_str());
-  var_ref->set_loc(ident->get_loc());
-  plist->append_kid(var_ref.release());
+  Token ident = expect(TOK_IDENTIFIER);
+  Node *var_ref = token_to_node(AST_VARREF, ident);
+  plist->append_kid(var_ref);
 
   // parse remaining params if any
   while (true) {
-    Node *next_tok = m_lexer->peek();
-    if (next_tok != nullptr && next_tok->get_tag() == TOK_COMMA) {
+    const Token *next_tok = m_lexer->peek();
+    if (next_tok != nullptr && next_tok->kind == TOK_COMMA) {
       expect_and_discard(TOK_COMMA);
-      std::unique_ptr<Node> ident(expect(TOK_IDENTIFIER));
-      std::unique_ptr<Node> var_ref(new Node(AST_VARREF));
-      var_ref->set_str(ident->get_str());
-      var_ref->set_loc(ident->get_loc());
-      plist->append_kid(var_ref.release());
+      Token ident = expect(TOK_IDENTIFIER);
+      Node *var_ref = token_to_node(AST_VARREF, ident);
+      plist->append_kid(var_ref);
     } else {
       break;
     }
   }
 
-  return plist.release();
+  return plist;
 }
 
 Node *Parser2::parse_OptArgList() {
-  Node *next_tok = m_lexer->peek();
+  const Token *next_tok = m_lexer->peek();
   if (next_tok != nullptr && can_start_expression(next_tok)) {
     return parse_ArgList();
   }
@@ -277,121 +358,33 @@ Node *Parser2::parse_OptArgList() {
 }
 
 // Helper function to determine if a token can start an expression
-bool Parser2::can_start_expression(Node *tok) {
-  int tag = tok->get_tag();
+bool Parser2::can_start_expression(const Token *tok) {
+  int tag = tok->kind;
   return tag == TOK_IDENTIFIER || tag == TOK_INTEGER_LITERAL || tag == TOK_LPAREN;
 }
 
 Node *Parser2::parse_ArgList() {
-  std::unique_ptr<Node> arglist(new Node(AST_ARGLIST));
+  Node *arglist = m_arena->new_node(AST_ARGLIST);
 
   // parse frist arg (L)
-  std::unique_ptr<Node> arg(parse_L());
-  arglist->append_kid(arg.release());
+  Node *arg = parse_L();
+  arglist->append_kid(arg);
 
   // parse remaining args if any
   while (true) {
-    Node *next_tok = m_lexer->peek();
-    if (next_tok != nullptr && next_tok->get_tag() == TOK_COMMA) {
+    const Token *next_tok = m_lexer->peek();
+    if (next_tok != nullptr && next_tok->kind == TOK_COMMA) {
       expect_and_discard(TOK_COMMA);
-      std::unique_ptr<Node> arg(parse_L()); //next arg
-      arglist->append_kid(arg.release());
+      Node *arg = parse_L(); //next arg
+      arglist->append_kid(arg);
     } else {
       break; // no more args
     }
   }
 
-  return arglist.release();
-}
-
-
-Node *Parser2::parse_E() {
-  // E -> ^ T E'
-
-  // Get the AST corresponding to the term (T)
-  Node *ast = parse_T();
-
-  // Recursively continue the additive expression
-  return parse_EPrime(ast);
-}
-
-// This function is passed the "current" portion of the AST
-// that has been built so far for the additive expression.
-Node *Parser2::parse_EPrime(Node *ast_) {
-  // E' -> ^ + T E'
-  // E' -> ^ - T E'
-  // E' -> ^ epsilon
-
-  std::unique_ptr<Node> ast(ast_);
-
-  // peek at next token
-  Node *next_tok = m_lexer->peek();
-  if (next_tok != nullptr) {
-    int next_tok_tag = next_tok->get_tag();
-    if (next_tok_tag == TOK_PLUS || next_tok_tag == TOK_MINUS)  {
-      // E' -> ^ + T E'
-      // E' -> ^ - T E'
-      std::unique_ptr<Node> op(expect(static_cast<enum TokenKind>(next_tok_tag)));
-
-      // build AST for next term, incorporate into current AST
-      Node *term_ast = parse_T();
-      ast.reset(new Node(next_tok_tag == TOK_PLUS ? AST_ADD : AST_SUB, {ast.release(), term_ast}));
-
-      // copy source information from operator node
-      ast->set_loc(op->get_loc());
-
-      // continue recursively
-      return parse_EPrime(ast.release());
-    }
-  }
-
-  // E' -> ^ epsilon
-  // No more additive operators, so just return the completed AST
-  return ast.release();
-}
-
-Node *Parser2::parse_T() {
-  // T -> F T'
-
-  // Parse primary expression
-  Node *ast = parse_F();
-
-  // Recursively continue the multiplicative expression
-  return parse_TPrime(ast);
+  return arglist;
 }
 
-Node *Parser2::parse_TPrime(Node *ast_) {
-  // T' -> ^ * F T'
-  // T' -> ^ / F T'
-  // T' -> ^ epsilon
-
-  std::unique_ptr<Node> ast(ast_);
-
-  // peek at next token
-  Node *next_tok = m_lexer->peek();
-  if (next_tok != nullptr) {
-    int next_tok_tag = next_tok->get_tag();
-    if (next_tok_tag == TOK_TIMES || next_tok_tag == TOK_DIVIDE)  {
-      // T' -> ^ * F T'
-      // T' -> ^ / F T'
-      std::unique_ptr<Node> op(expect(static_cast<enum TokenKind>(next_tok_tag)));
-
-      // build AST for next primary expression, incorporate into current AST
-      Node *primary_ast = parse_F();
-      ast.reset(new Node(next_tok_tag == TOK_TIMES ? AST_MULTIPLY : AST_DIVIDE, {ast.release(), primary_ast}));
-
-      // copy source information from operator node
-      ast->set_loc(op->get_loc());
-
-      // continue recursively
-      return parse_TPrime(ast.release());
-    }
-  }
-
-  // T' -> ^ epsilon
-  // No more multiplicative operators, so just return the completed AST
-  return ast.release();
-}
 
 Node *Parser2::parse_F() {
   // F -> ^ number
@@ -399,64 +392,57 @@ Node *Parser2::parse_F() {
   // F -> ^ ( E )
   // F →          ident ( OptArgList )             -- function call
 
-  Node *next_tok = m_lexer->peek();
+  const Token *next_tok = m_lexer->peek();
   if (next_tok == nullptr) {
     error_at_current_loc("Unexpected end of input looking for primary expression");
   }
 
-  int tag = next_tok->get_tag();
+  int tag = next_tok->kind;
   
   if (tag == TOK_IDENTIFIER) {
     // Could be function call or var reference
-    std::unique_ptr<Node> ident(expect(TOK_IDENTIFIER));
-    Node *next_tok = m_lexer->peek();
+    Token ident = expect(TOK_IDENTIFIER);
+    const Token *next_tok = m_lexer->peek();
 
-    if (next_tok != nullptr && next_tok->get_tag() == TOK_LPAREN) {
+    if (next_tok != nullptr && next_tok->kind == TOK_LPAREN) {
       // Function call
       expect_and_discard(TOK_LPAREN);
-      std::unique_ptr<Node> arglist(parse_OptArgList());
+      Node *arglist = parse_OptArgList();
       expect_and_discard(TOK_RPAREN);
 
       // AST_FNCALL
       std::vector<Node *> children;
-      std::unique_ptr<Node> var_ref(new Node(AST_VARREF));
-      var_ref->set_str(ident->get_str());
-      var_ref->set_loc(ident->get_loc());
-      children.push_back(var_ref.release());
+      Node *var_ref = token_to_node(AST_VARREF, ident);
+      children.push_back(var_ref);
 
       if (arglist != nullptr) {
-        children.push_back(arglist.release());
+        children.push_back(arglist);
       }
 
-      std::unique_ptr<Node> fncall(new Node(AST_FNCALL, children));
-      fncall->set_loc(ident->get_loc());
+      Node *fncall = m_arena->new_node(AST_FNCALL, children);
+      fncall->set_loc(m_lexer->get_loc(ident));
 
-      return fncall.release();
+      return fncall;
 
     } else {
       // Variable reference identifier
-      std::unique_ptr<Node> var_ref(new Node(AST_VARREF));
-      var_ref->set_str(ident->get_str());
-      var_ref->set_loc(ident->get_loc());
-      return var_ref.release();
+      Node *var_ref = token_to_node(AST_VARREF, ident);
+      return var_ref;
     }
   } else if (tag == TOK_INTEGER_LITERAL) {
     // F -> number
-    std::unique_ptr<Node> tok(expect(TOK_INTEGER_LITERAL));
-    std::unique_ptr<Node> ast(new Node(AST_INT_LITERAL));
+    Token tok = expect(TOK_INTEGER_LITERAL);
+    Node *ast = token_to_node(AST_INT_LITERAL, tok);
 
-    ast->set_str(tok->get_str());
-    ast->set_loc(tok->get_loc());
-
-    return ast.release();
+    return ast;
   } else if (tag == TOK_LPAREN) {
     // F -> ( E )
     expect_and_discard(TOK_LPAREN);
-    std::unique_ptr<Node> ast(parse_A());
+    Node *ast = parse_A();
     expect_and_discard(TOK_RPAREN);
-    return ast.release();
+    return ast;
   } else {
-    SyntaxError::raise(next_tok->get_loc(), "Invalid primary expression");
+    SyntaxError::raise(m_lexer->get_loc(*next_tok), "Invalid primary expression");
   }
 }
 
@@ -478,31 +464,29 @@ Node *Parser2::parse_F() {
 Node *Parser2::parse_A() {
   // A    → ident = A
   // A    → L
-  Node *next_tok = m_lexer->peek();
+  const Token *next_tok = m_lexer->peek();
   if (next_tok == nullptr) {
     error_at_current_loc("Unexpected end of input looking for assignment or expression");
   }
 
-  if (next_tok->get_tag() == TOK_IDENTIFIER) {
+  if (next_tok->kind == TOK_IDENTIFIER) {
     // Peek two tokens ahead to check for the assignment operator (`=`)
-    Node *next_next_tok = m_lexer->peek(2);
+    const Token *next_next_tok = m_lexer->peek<2>();
     
-    if (next_next_tok != nullptr && next_next_tok->get_tag() == TOK_EQUAL) {
+    if (next_next_tok != nullptr && next_next_tok->kind == TOK_EQUAL) {
       // If the second token is '=', it's an assignment: A → ident = A
-      std::unique_ptr<Node> ident(expect(TOK_IDENTIFIER));  // Consume identifier
+      Token ident = expect(TOK_IDENTIFIER);  // Consume identifier
       
       // Create an AST_VARREF node for the left-hand side variable reference
-      std::unique_ptr<Node> var_ref(new Node(AST_VARREF));
-      var_ref->set_str(ident->get_str());
-      var_ref->set_loc(ident->get_loc());
+      Node *var_ref = token_to_node(AST_VARREF, ident);
       
-      std::unique_ptr<Node> assign_op(expect(TOK_EQUAL));   // Consume '='
-      std::unique_ptr<Node> rhs(parse_A());                 // Parse the right-hand side of the assignment
+      Token assign_op = expect(TOK_EQUAL);   // Consume '='
+      Node *rhs = parse_A();                 // Parse the right-hand side of the assignment
 
       // Create AST node for assignment operation
-      std::unique_ptr<Node> assign_node(new Node(AST_ASSIGN, {var_ref.release(), rhs.release()}));
-      assign_node->set_loc(assign_op->get_loc());            // Set location info from the assignment operator
-      return assign_node.release();
+      Node *assign_node = m_arena->new_node(AST_ASSIGN, {var_ref, rhs});
+      assign_node->set_loc(m_lexer->get_loc(assign_op));            // Set location info from the assignment operator
+      return assign_node;
     }
   }
 
@@ -514,67 +498,459 @@ Node *Parser2::parse_L() {
   // L    → R || R
   // L    → R && R
   // L    → R
-  std::unique_ptr<Node> ast(parse_R());
-
-  Node *next_tok = m_lexer->peek();
-  if (next_tok != nullptr) {
-    if (next_tok->get_tag() == TOK_DOUBLE_PIPE || next_tok->get_tag() == TOK_DOUBLE_AMPERSAND) {
-      std::unique_ptr<Node> logical_op(expect(next_tok->get_tag() == TOK_DOUBLE_PIPE ? TOK_DOUBLE_PIPE : TOK_DOUBLE_AMPERSAND));
-      std::unique_ptr<Node> rhs(parse_R());
-      int ast_tag = (next_tok->get_tag() == TOK_DOUBLE_PIPE) ? AST_LOGICAL_OR : AST_LOGICAL_AND;
-      std::unique_ptr<Node> logical_node(new Node(ast_tag, {ast.release(), rhs.release()}));
-      logical_node->set_loc(logical_op->get_loc());
-      return logical_node.release();
+  // (R, E, and T are parsed by parse_BinaryExpr() as well)
+  return parse_BinaryExpr(1);
+}
+
+// Parse a binary expression containing only operators with precedence
+// min_prec or higher, by precedence climbing: operands are parsed by
+// parse_F(), and each operator's right operand is parsed by a recursive
+// call that only accepts operators which bind more tightly.  So, the
+// recursion depth is bounded by the number of precedence levels,
+// rather than by the length of the expression.
+Node *Parser2::parse_BinaryExpr(int min_prec) {
+  Node *ast = parse_F();
+
+  // operators with precedence greater than this can't continue
+  // the expression (used to make nonassociative operators
+  // such as < and || non-chaining)
+  int max_prec = MAX_PRECEDENCE;
+
+  for (;;) {
+    const Token *next_tok = m_lexer->peek();
+    if (next_tok == nullptr) {
+      break;
+    }
+    const BinaryOp &op_info = get_binary_op(next_tok->kind);
+    if (op_info.prec < min_prec || op_info.prec > max_prec) {
+      break; // not a binary operator, or not one that can continue this expression
     }
-  }
 
-  return ast.release();
-}
+    Token op = m_lexer->next();
+    Node *rhs = parse_BinaryExpr(op_info.prec + 1);
+    ast = m_arena->new_node(op_info.ast_tag, {ast, rhs});
+
+    // copy source information from operator node
+    ast->set_loc(m_lexer->get_loc(op));
 
-Node *Parser2::parse_R() {
-  std::unique_ptr<Node> ast(parse_E());
-
-  Node *next_tok = m_lexer->peek();
-
-  if (next_tok != nullptr) {
-    int tok_tag = next_tok->get_tag();
-    if (tok_tag == TOK_LESS || tok_tag == TOK_LESS_EQUAL || tok_tag == TOK_GREATER || tok_tag == TOK_GREATER_EQUAL || 
-        tok_tag == TOK_DOUBLE_EQUAL || tok_tag == TOK_NOT_EQUAL) {
-      std::unique_ptr<Node> rel_op(expect(static_cast<TokenKind>(tok_tag)));
-      std::unique_ptr<Node> rhs(parse_E());
-      int ast_tag; 
-      switch (tok_tag) {
-        case TOK_LESS: ast_tag = AST_LESS; break;
-        case TOK_LESS_EQUAL: ast_tag = AST_LESS_EQUAL; break;
-        case TOK_GREATER: ast_tag = AST_GREATER; break;
-        case TOK_GREATER_EQUAL: ast_tag = AST_GREATER_EQUAL; break;
-        case TOK_DOUBLE_EQUAL: ast_tag = AST_EQUAL; break;
-        case TOK_NOT_EQUAL: ast_tag = AST_NOT_EQUAL; break;
-        default: error_at_current_loc("Unexpected relational operator");
-      } 
-
-      std::unique_ptr<Node> rel_node(new Node(ast_tag, {ast.release(), rhs.release()}));
-      rel_node->set_loc(rel_op->get_loc());
-      return rel_node.release();
+    if (op_info.assoc == NONASSOC) {
+      max_prec = op_info.prec - 1;
     }
   }
 
-  return ast.release();
+  return ast;
 }
 
-Node *Parser2::expect(enum TokenKind tok_kind) {
-  std::unique_ptr<Node> next_terminal(m_lexer->next());
-  if (next_terminal->get_tag() != tok_kind) {
-    SyntaxError::raise(next_terminal->get_loc(), "Unexpected token '%s'", next_terminal->get_str().c_str());
+Token Parser2::expect(enum TokenKind tok_kind) {
+  Token next_terminal = m_lexer->next();
+  if (next_terminal.kind != tok_kind) {
+    SyntaxError::raise(m_lexer->get_loc(next_terminal), "Unexpected token '%.*s'", int(next_terminal.len), m_lexer->get_text(next_terminal));
   }
-  return next_terminal.release();
+  return next_terminal;
 }
 
 void Parser2::expect_and_discard(enum TokenKind tok_kind) {
-  Node *tok = expect(tok_kind);
-  delete tok;
+  expect(tok_kind);
+}
+
+// Create an AST leaf (e.g., AST_VARREF or AST_INT_LITERAL) from a token.
+// This is the only point at which the parser turns tokens into Nodes.
+Node *Parser2::token_to_node(int ast_tag, const Token &tok) {
+  Node *node = m_arena->new_node(ast_tag, m_lexer->get_lexeme(tok));
+  node->set_loc(m_lexer->get_loc(tok));
+  node->set_symbol(tok.sym);
+  if (ast_tag == AST_INT_LITERAL) {
+    // decode the value once here, so evaluating the literal
+    // doesn't have to
+    std::string_view digits = node->get_str();
+    int value;
+    if (!decode_int_literal(digits, value)) {
+      SyntaxError::raise(node->get_loc(), "Integer literal '%.*s' is out of range", int(digits.size()), digits.data());
+    }
+    node->set_int_value(value);
+  }
+  return node;
+}
+
+bool Parser2::decode_int_literal(std::string_view digits, int &value) {
+  std::from_chars_result res = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+  return res.ec == std::errc() && res.ptr == digits.data() + digits.size();
 }
 
 void Parser2::error_at_current_loc(const std::string &msg) {
   SyntaxError::raise(m_lexer->get_current_loc(), "%s", msg.c_str());
 }
+
+////////////////////////////////////////////////////////////////////////
+// Explicit-stack parsing
+////////////////////////////////////////////////////////////////////////
+
+// parse_with_stack() recognizes the same language, builds the same AST,
+// and reports the same errors as the recursive parse functions above,
+// but each pending nonterminal is a ParseFrame on a heap-allocated stack
+// rather than an activation of a C++ function.  When a frame finishes,
+// its AST is left in "result" for the frame below it, which then
+// resumes at the step where the recursive version would have returned.
+
+namespace {
+
+struct ParseFrame {
+  enum Kind {
+    UNIT,      // Unit (the bottom of the stack)
+    STMT,      // Stmt
+    IF,        // Stmt -> if ( A ) { SList } [else { SList }]
+    WHILE,     // Stmt -> while ( A ) { SList }
+    FUNC,      // Func
+    SLIST,     // SList
+    A,         // A
+    ASSIGN,    // A -> ident = A
+    BINARY,    // L, R, E, or T (see parse_BinaryExpr())
+    F,         // F
+    PAREN,     // F -> ( A )
+    CALL,      // F -> ident ( ArgList )
+  };
+
+  Kind kind;
+  int step;                    // how far the frame has gotten
+  bool nested;                 // true if the frame counts towards the depth limit
+  Node *node;                  // AST being built
+  Node *kid;                   // AST of an earlier part (e.g., an if's condition)
+  Node *kid2;
+  Token tok;                   // token giving the AST's location
+  int min_prec, max_prec;      // for BINARY frames
+  const BinaryOp *op;          // BINARY: pending operator
+
+  ParseFrame(Kind kind_, int min_prec_ = 0)
+    : kind(kind_), step(0), nested(false), node(nullptr), kid(nullptr), kid2(nullptr), tok(), min_prec(min_prec_)
+    , max_prec(MAX_PRECEDENCE), op(nullptr) { }
+};
+
+}
+
+Node *Parser2::parse_with_stack() {
+  std::vector<ParseFrame> stack;
+  Node *result = nullptr;
+  int depth = 0;
+
+  // Mark the frame on top of the stack as a level of nesting,
+  // checking the depth limit
+  auto enter_nested = [&](const Token &tok) {
+    if (m_max_depth > 0 && depth >= m_max_depth) {
+      SyntaxError::raise(m_lexer->get_loc(tok), "Nesting is too deep (the limit is %d levels)", m_max_depth);
+    }
+    depth++;
+    stack.back().nested = true;
+  };
+
+  // Pop the frame on top of the stack, leaving its AST in result
+  auto finish = [&](Node *ast) {
+    if (stack.back().nested) {
+      depth--;
+    }
+    stack.pop_back();
+    result = ast;
+  };
+
+  // TStmt -> Func
+  // TStmt -> Stmt
+  auto push_TStmt = [&]() {
+    const Token *next_tok = m_lexer->peek();
+    if (next_tok == nullptr) {
+      SyntaxError::raise(m_lexer->get_current_loc(), "Unexpected end of input looking for statement");
+    }
+    stack.emplace_back(next_tok->kind == TOK_FUNCTION ? ParseFrame::FUNC : ParseFrame::STMT);
+  };
+
+  // Consume a '{' and start parsing the SList after it
+  auto push_block = [&]() {
+    Token lbrace = expect(TOK_LBRACE);
+    stack.emplace_back(ParseFrame::SLIST);
+    enter_nested(lbrace);
+  };
+
+  stack.emplace_back(ParseFrame::UNIT);
+
+  // Note that pushing a frame invalidates references to the
+  // frames on the stack, so f is only used before that happens
+  for (;;) {
+    ParseFrame &f = stack.back();
+    switch (f.kind) {
+    case ParseFrame::UNIT:
+      if (f.step == 0) {
+        f.node = m_arena->new_node(AST_UNIT);
+        f.step = 1;
+      } else {
+        f.node->append_kid(result);
+        if (m_lexer->peek() == nullptr) {
+          return f.node;
+        }
+      }
+      push_TStmt();
+      break;
+
+    case ParseFrame::STMT:
+      if (f.step == 0) {
+        f.node = m_arena->new_node(AST_STATEMENT);
+        const Token *next_tok = m_lexer->peek();
+        if (next_tok == nullptr) {
+          SyntaxError::raise(m_lexer->get_current_loc(), "Unexpected end of input looking for statement");
+        }
+        switch (next_tok->kind) {
+          case TOK_VAR:
+            f.node->append_kid(parse_varDec());
+            finish(f.node);
+            break;
+          case TOK_IF:
+            f.step = 1;
+            stack.emplace_back(ParseFrame::IF);
+            break;
+          case TOK_WHILE:
+            f.step = 1;
+            stack.emplace_back(ParseFrame::WHILE);
+            break;
+          default:
+            f.step = 2;
+            stack.emplace_back(ParseFrame::A);
+            break;
+        }
+      } else {
+        f.node->append_kid(result);
+        if (f.step == 2) {
+          expect_and_discard(TOK_SEMICOLON);
+        }
+        finish(f.node);
+      }
+      break;
+
+    case ParseFrame::IF:
+      if (f.step == 0) {
+        f.tok = expect(TOK_IF);
+        expect_and_discard(TOK_LPAREN);
+        f.step = 1;
+        stack.emplace_back(ParseFrame::A);
+      } else if (f.step == 1) {
+        f.kid = result;  // condition
+        expect_and_discard(TOK_RPAREN);
+        f.step = 2;
+        push_block();
+      } else {
+        expect_and_discard(TOK_RBRACE);
+        if (f.step == 2) {
+          f.kid2 = result;  // statements executed if true
+          const Token *next_tok = m_lexer->peek();
+          if (next_tok != nullptr && next_tok->kind == TOK_ELSE) {
+            expect_and_discard(TOK_ELSE);
+            f.step = 3;
+            push_block();
+            break;
+          }
+        }
+        std::vector<Node *> children = { f.kid, f.kid2 };
+        if (f.step == 3) {
+          children.push_back(result);  // else statements
+        }
+        Node *if_node = m_arena->new_node(AST_IF, children);
+        if_node->set_loc(m_lexer->get_loc(f.tok));
+        finish(if_node);
+      }
+      break;
+
+    case ParseFrame::WHILE:
+      if (f.step == 0) {
+        f.tok = expect(TOK_WHILE);
+        expect_and_discard(TOK_LPAREN);
+        f.step = 1;
+        stack.emplace_back(ParseFrame::A);
+      } else if (f.step == 1) {
+        f.kid = result;  // condition
+        expect_and_discard(TOK_RPAREN);
+        f.step = 2;
+        push_block();
+      } else {
+        expect_and_discard(TOK_RBRACE);
+        std::vector<Node *> children = { f.kid, result };
+        Node *while_node = m_arena->new_node(AST_WHILE, children);
+        while_node->set_loc(m_lexer->get_loc(f.tok));
+        finish(while_node);
+      }
+      break;
+
+    case ParseFrame::FUNC:
+      if (f.step == 0) {
+        f.tok = expect(TOK_FUNCTION);
+        Token ident = expect(TOK_IDENTIFIER);
+        f.kid = token_to_node(AST_VARREF, ident);
+        expect_and_discard(TOK_LPAREN);
+        f.kid2 = parse_OptPList();
+        expect_and_discard(TOK_RPAREN);
+        f.step = 1;
+        if (m_lazy_bodies) {
+          Token lbrace = expect(TOK_LBRACE);
+          result = skip_function_body(lbrace);
+        } else {
+          push_block();
+        }
+      } else {
+        expect_and_discard(TOK_RBRACE);
+        std::vector<Node *> children;
+        children.push_back(f.kid);
+        if (f.kid2) {
+          children.push_back(f.kid2);
+        }
+        children.push_back(result);
+        Node *func_node = m_arena->new_node(AST_FUNCTION, children);
+        func_node->set_loc(m_lexer->get_loc(f.tok));
+        finish(func_node);
+      }
+      break;
+
+    case ParseFrame::SLIST:
+      if (f.step == 0) {
+        f.node = m_arena->new_node(AST_STATEMENT_LIST);
+        f.step = 1;
+      } else {
+        f.node->append_kid(result);
+      }
+      {
+        const Token *next_tok = m_lexer->peek();
+        if (next_tok == nullptr || next_tok->kind == TOK_RBRACE) {
+          finish(f.node);
+        } else {
+          stack.emplace_back(ParseFrame::STMT);
+        }
+      }
+      break;
+
+    case ParseFrame::A:
+      if (f.step == 0) {
+        const Token *next_tok = m_lexer->peek();
+        if (next_tok == nullptr) {
+          error_at_current_loc("Unexpected end of input looking for assignment or expression");
+        }
+        if (next_tok->kind == TOK_IDENTIFIER) {
+          const Token *next_next_tok = m_lexer->peek<2>();
+          if (next_next_tok != nullptr && next_next_tok->kind == TOK_EQUAL) {
+            // A -> ident = A
+            Token ident = expect(TOK_IDENTIFIER);
+            f.kind = ParseFrame::ASSIGN;
+            f.kid = token_to_node(AST_VARREF, ident);
+            f.tok = expect(TOK_EQUAL);
+            enter_nested(f.tok);
+            stack.emplace_back(ParseFrame::A);
+            break;
+          }
+        }
+        // A -> L
+        f.step = 1;
+        stack.emplace_back(ParseFrame::BINARY, 1);
+      } else {
+        finish(result);
+      }
+      break;
+
+    case ParseFrame::ASSIGN:
+      {
+        Node *assign_node = m_arena->new_node(AST_ASSIGN, {f.kid, result});
+        assign_node->set_loc(m_lexer->get_loc(f.tok));
+        finish(assign_node);
+      }
+      break;
+
+    case ParseFrame::BINARY:
+      if (f.step == 0) {
+        f.step = 1;
+        stack.emplace_back(ParseFrame::F);
+        break;
+      }
+      if (f.op == nullptr) {
+        f.node = result;  // first operand
+      } else {
+        f.node = m_arena->new_node(f.op->ast_tag, {f.node, result});
+        f.node->set_loc(m_lexer->get_loc(f.tok));
+        if (f.op->assoc == NONASSOC) {
+          f.max_prec = f.op->prec - 1;
+        }
+      }
+      {
+        const Token *next_tok = m_lexer->peek();
+        const BinaryOp *op_info = (next_tok != nullptr) ? &get_binary_op(next_tok->kind) : nullptr;
+        if (op_info == nullptr || op_info->prec < f.min_prec || op_info->prec > f.max_prec) {
+          finish(f.node);
+        } else {
+          f.tok = m_lexer->next();
+          f.op = op_info;
+          stack.emplace_back(ParseFrame::BINARY, op_info->prec + 1);
+        }
+      }
+      break;
+
+    case ParseFrame::F:
+      {
+        const Token *next_tok = m_lexer->peek();
+        if (next_tok == nullptr) {
+          error_at_current_loc("Unexpected end of input looking for primary expression");
+        }
+        int tag = next_tok->kind;
+        if (tag == TOK_IDENTIFIER) {
+          Token ident = expect(TOK_IDENTIFIER);
+          next_tok = m_lexer->peek();
+          if (next_tok != nullptr && next_tok->kind == TOK_LPAREN) {
+            // F -> ident ( OptArgList )
+            Token lparen = expect(TOK_LPAREN);
+            f.kind = ParseFrame::CALL;
+            f.tok = ident;
+            enter_nested(lparen);
+            next_tok = m_lexer->peek();
+            if (next_tok != nullptr && can_start_expression(next_tok)) {
+              stack.back().node = m_arena->new_node(AST_ARGLIST);
+              stack.emplace_back(ParseFrame::BINARY, 1);
+            }
+          } else {
+            finish(token_to_node(AST_VARREF, ident));
+          }
+        } else if (tag == TOK_INTEGER_LITERAL) {
+          Token tok = expect(TOK_INTEGER_LITERAL);
+          finish(token_to_node(AST_INT_LITERAL, tok));
+        } else if (tag == TOK_LPAREN) {
+          // F -> ( A )
+          Token lparen = expect(TOK_LPAREN);
+          f.kind = ParseFrame::PAREN;
+          enter_nested(lparen);
+          stack.emplace_back(ParseFrame::A);
+        } else {
+          SyntaxError::raise(m_lexer->get_loc(*next_tok), "Invalid primary expression");
+        }
+      }
+      break;
+
+    case ParseFrame::PAREN:
+      expect_and_discard(TOK_RPAREN);
+      finish(result);
+      break;
+
+    case ParseFrame::CALL:
+      if (f.node) {
+        // result is an argument
+        f.node->append_kid(result);
+        const Token *next_tok = m_lexer->peek();
+        if (next_tok != nullptr && next_tok->kind == TOK_COMMA) {
+          expect_and_discard(TOK_COMMA);
+          stack.emplace_back(ParseFrame::BINARY, 1);
+          break;
+        }
+      }
+      {
+        expect_and_discard(TOK_RPAREN);
+        std::vector<Node *> children;
+        children.push_back(token_to_node(AST_VARREF, f.tok));
+        if (f.node) {
+          children.push_back(f.node);
+        }
+        Node *fncall = m_arena->new_node(AST_FNCALL, children);
+        fncall->set_loc(m_lexer->get_loc(f.tok));
+        finish(fncall);
+      }
+      break;
+    }
+  }
+}
@@ -1,20 +1,61 @@
 #ifndef PARSER2_H
 #define PARSER2_H
 
+#include <string_view>
 #include "lexer.h"
 #include "node.h"
 
+class ASTArena;
+
 class Parser2 {
+public:
+  // Default limit on the nesting depth of constructs when parsing
+  // with an explicit stack (see set_use_stack())
+  static const int DEFAULT_MAX_DEPTH = 10000;
+
 private:
   Lexer *m_lexer;
+  ASTArena *m_arena;
   Node *m_next;
+  bool m_use_stack;
+  int m_max_depth;
+  bool m_lazy_bodies;
 
 public:
-  Parser2(Lexer *lexer_to_adopt);
+  // The nodes of the AST are allocated in the given arena,
+  // which must outlive them (the Parser2 doesn't adopt it).
+  Parser2(Lexer *lexer_to_adopt, ASTArena *arena);
   ~Parser2();
 
+  // If use_stack is true, parse() keeps its state on a heap-allocated
+  // stack rather than calling itself recursively, so the depth of
+  // nesting in the source is limited only by set_max_depth() rather
+  // than by the size of the native stack.  The resulting AST is the same.
+  void set_use_stack(bool use_stack) { m_use_stack = use_stack; }
+
+  // Set the maximum depth of nested parentheses, blocks, function call
+  // arguments, and assignments accepted when parsing with an explicit stack.
+  // Deeper nesting is reported as a SyntaxError.  0 means no limit.
+  void set_max_depth(int max_depth) { m_max_depth = max_depth; }
+
+  // If lazy_bodies is true, function bodies are not parsed: the braces
+  // around each body are matched, and the body is represented by an
+  // AST_LAZY_STATEMENT_LIST node referring to its source text.
+  // parse_lazy_body() must be called before the body is used.
+  void set_lazy_function_bodies(bool lazy_bodies) { m_lazy_bodies = lazy_bodies; }
+
   Node *parse();
 
+  // Parse the source text of an AST_LAZY_STATEMENT_LIST node, replacing
+  // the node's contents with the resulting AST_STATEMENT_LIST, whose
+  // nodes are allocated in the body's arena.
+  // Throws SyntaxError if the function body is not valid.
+  static void parse_lazy_body(Node *body);
+
+  // Decode the digits of an integer literal.  Returns false if the
+  // value doesn't fit in an int.
+  static bool decode_int_literal(std::string_view digits, int &value);
+
 private:
   // Parse functions for nonterminal grammar symbols
   Node *parse_Unit();
@@ -26,27 +67,33 @@ private:
   Node *parse_SList();
   Node *parse_OptArgList();
   Node *parse_ArgList();
-  Node *parse_E();
-  Node *parse_EPrime(Node *ast);
-  Node *parse_T();
-  Node *parse_TPrime(Node *ast);
   Node *parse_F();
   Node *parse_A();
   Node *parse_L();
-  Node *parse_R();
+  Node *parse_BinaryExpr(int min_prec);
+
+  // Non-recursive version of parse_Unit()
+  Node *parse_with_stack();
+
+  // Skip a function body whose '{' has just been consumed,
+  // returning an AST_LAZY_STATEMENT_LIST for it
+  Node *skip_function_body(const Token &lbrace);
 
   // Helpers
   Node *parse_varDec();
   Node *parse_If();
   Node *parse_While();
-  bool can_start_expression(Node *tok);
+  bool can_start_expression(const Token *tok);
 
-  // Consume a specific token, wrapping it in a Node
-  Node *expect(enum TokenKind tok_kind);
+  // Consume a specific token
+  Token expect(enum TokenKind tok_kind);
 
   // Consume a specific token and discard it
   void expect_and_discard(enum TokenKind tok_kind);
 
+  // Create an AST leaf node from a token
+  Node *token_to_node(int ast_tag, const Token &tok);
+
   // Report an error at current lexer position
   void error_at_current_loc(const std::string &msg);
 };
@@ -0,0 +1,563 @@
+#include <cassert>
+#include <algorithm>
+#include "ast.h"
+#include "node.h"
+#include "exceptions.h"
+#include "environment.h"
+#include "function.h"
+#include "regcode.h"
+
+namespace {
+
+// The fields of an instruction which are registers (1 for a, 2 for b,
+// 4 for c)
+unsigned register_fields(RegOpcode op) {
+  switch (op) {
+  case REG_LOAD_INT:
+  case REG_LOAD_GLOBAL:
+  case REG_LOAD_GLOBAL_FN:
+  case REG_STORE_GLOBAL:
+  case REG_JUMP_IF_FALSE:
+  case REG_JUMP_IF_TRUE:
+  case REG_CALL:
+  case REG_RETURN:
+    return 1;
+  case REG_MOVE:
+  case REG_AND:
+  case REG_OR:
+  case REG_TO_BOOL:
+    return 1 | 2;
+  case REG_ADD:
+  case REG_SUB:
+  case REG_MULTIPLY:
+  case REG_DIVIDE:
+  case REG_LESS:
+  case REG_LESS_EQUAL:
+  case REG_GREATER:
+  case REG_GREATER_EQUAL:
+  case REG_EQUAL:
+  case REG_NOT_EQUAL:
+    return 1 | 2 | 4;
+  case REG_JLT:
+  case REG_JLE:
+  case REG_JGT:
+  case REG_JGE:
+  case REG_JEQ:
+  case REG_JNE:
+    return 1 | 2;
+  default:
+    return 0;
+  }
+}
+
+RegOpcode binary_opcode(int tag) {
+  switch (tag) {
+  case AST_ADD:           return REG_ADD;
+  case AST_SUB:           return REG_SUB;
+  case AST_MULTIPLY:      return REG_MULTIPLY;
+  case AST_DIVIDE:        return REG_DIVIDE;
+  case AST_LESS:          return REG_LESS;
+  case AST_LESS_EQUAL:    return REG_LESS_EQUAL;
+  case AST_GREATER:       return REG_GREATER;
+  case AST_GREATER_EQUAL: return REG_GREATER_EQUAL;
+  case AST_EQUAL:         return REG_EQUAL;
+  case AST_NOT_EQUAL:     return REG_NOT_EQUAL;
+  default:
+    RuntimeError::raise("Unknown AST node type %d during compilation.", tag);
+  }
+}
+
+bool is_comparison(int tag) {
+  return tag == AST_LESS || tag == AST_LESS_EQUAL || tag == AST_GREATER ||
+         tag == AST_GREATER_EQUAL || tag == AST_EQUAL || tag == AST_NOT_EQUAL;
+}
+
+// The compare-and-jump instruction which jumps if a comparison is
+// true (or, if jump_if is false, if it is false)
+RegOpcode jump_opcode(int tag, bool jump_if) {
+  switch (tag) {
+  case AST_LESS:          return jump_if ? REG_JLT : REG_JGE;
+  case AST_LESS_EQUAL:    return jump_if ? REG_JLE : REG_JGT;
+  case AST_GREATER:       return jump_if ? REG_JGT : REG_JLE;
+  case AST_GREATER_EQUAL: return jump_if ? REG_JGE : REG_JLT;
+  case AST_EQUAL:         return jump_if ? REG_JEQ : REG_JNE;
+  case AST_NOT_EQUAL:     return jump_if ? REG_JNE : REG_JEQ;
+  default:
+    RuntimeError::raise("Unknown AST node type %d during compilation.", tag);
+  }
+}
+
+Function *new_function(const std::string &name, const std::vector<Symbol> &params, Environment *env, Node *body) {
+  return new Function(name, params, env, body);
+}
+
+Function *new_function(const std::string &name, const std::vector<Symbol> &params, Environment *env, FlatNode body) {
+  return new Function(name, params, env, body);
+}
+
+}
+
+RegisterCode::RegisterCode()
+  : m_constants_base(0)
+  , m_num_regs(0)
+#ifdef THREADED_DISPATCH
+  , m_threaded(false)
+#endif
+{
+}
+
+#ifdef THREADED_DISPATCH
+void RegisterCode::thread(const void *const handlers[]) const {
+  for (RegInstruction &ins : m_code) {
+    ins.handler = handlers[ins.op];
+  }
+  m_threaded = true;
+}
+#endif
+
+RegisterCompiler::RegisterCompiler(Environment *globals)
+  : m_globals(globals)
+  , m_out(nullptr)
+  , m_top(0)
+  , m_num_params(0) {
+}
+
+RegisterCompiler::~RegisterCompiler() {
+}
+
+const RegisterCode *RegisterCompiler::compile_program(Node *unit) {
+  compile_unit(unit);
+  return m_compiled.back().get();
+}
+
+const RegisterCode *RegisterCompiler::compile_program(FlatNode unit) {
+  compile_unit(unit);
+  return m_compiled.back().get();
+}
+
+const RegisterCode *RegisterCompiler::compile_function(Function *fn) {
+  if (fn->get_register_code() == nullptr) {
+    unsigned num_params = fn->get_num_params();
+    if (fn->get_flat_body()) {
+      compile_body(fn->get_flat_body(), num_params);
+    } else {
+      compile_body(fn->get_body(), num_params);
+    }
+    fn->set_register_code(m_compiled.back().get());
+  }
+  return fn->get_register_code();
+}
+
+// The program is executed in the global environment, so the
+// variables it defines are global variables
+template<typename NodeRef>
+void RegisterCompiler::compile_unit(NodeRef unit) {
+  start(new RegisterCode(), 0);
+  unsigned num_kids = unit->get_num_kids();
+  int result = num_kids == 0 ? constant(0) : -1;
+  for (unsigned i = 0; i < num_kids; ++i) {
+    if (i == num_kids - 1) {
+      result = compile_value(unit->get_kid(i), -1);
+    } else {
+      compile_statement(unit->get_kid(i));
+    }
+  }
+  emit(REG_RETURN, unit->get_loc(), result);
+  finish();
+}
+
+// The arguments of a call are in its first registers
+template<typename NodeRef>
+void RegisterCompiler::compile_body(NodeRef body, unsigned num_params) {
+  start(new RegisterCode(), num_params);
+  push_scope(num_params, num_params);
+  int result = compile_value(body, -1);
+  emit(REG_RETURN, body->get_loc(), result);
+  finish();
+}
+
+void RegisterCompiler::start(RegisterCode *out, unsigned num_params) {
+  m_compiled.push_back(std::unique_ptr<RegisterCode>(out));
+  m_out = out;
+  m_scopes.clear();
+  m_top = 0;
+  m_num_params = num_params;
+  m_constant_index.clear();
+}
+
+// Now that the number of constants is known, put them in the registers
+// following the parameters.  They can't follow the temporaries, since
+// the frame of a call made by the code overlaps those.
+void RegisterCompiler::finish() {
+  int num_params = int(m_num_params);
+  int num_constants = int(m_out->m_constants.size());
+  auto relocate = [num_params, num_constants](int &reg) {
+    if (reg & CONSTANT_FLAG) {
+      reg = num_params + (reg & ~CONSTANT_FLAG);
+    } else if (reg >= num_params) {
+      reg += num_constants;
+    }
+  };
+  for (RegInstruction &ins : m_out->m_code) {
+    unsigned fields = register_fields(ins.op);
+    if (fields & 1) {
+      relocate(ins.a);
+    }
+    if (fields & 2) {
+      relocate(ins.b);
+    }
+    if (fields & 4) {
+      relocate(ins.c);
+    }
+  }
+  m_out->m_constants_base = m_num_params;
+  m_out->m_num_regs += num_constants;
+}
+
+unsigned RegisterCompiler::emit(RegOpcode op, const Location &loc, int a, int b, int c, Symbol name) {
+  unsigned pc = unsigned(m_out->m_code.size());
+  m_out->m_code.push_back({ op, a, b, c });
+  m_out->m_locs.push_back(loc);
+  m_out->m_names.push_back(name);
+  return pc;
+}
+
+void RegisterCompiler::set_jump_target(unsigned pc, unsigned target) {
+  m_out->m_code[pc].c = int(target);
+}
+
+int RegisterCompiler::new_temp() {
+  unsigned reg = m_top++;
+  m_out->m_num_regs = std::max(m_out->m_num_regs, m_top);
+  return int(reg);
+}
+
+int RegisterCompiler::constant(int value) {
+  auto i = m_constant_index.find(value);
+  if (i != m_constant_index.end()) {
+    return int(CONSTANT_FLAG | i->second);
+  }
+  unsigned index = unsigned(m_out->m_constants.size());
+  m_out->m_constants.push_back(Value(value));
+  m_constant_index[value] = index;
+  return int(CONSTANT_FLAG | index);
+}
+
+// The value of a statement which has none
+int RegisterCompiler::load_zero(int dest, const Location &loc) {
+  if (dest < 0) {
+    return constant(0);
+  }
+  emit(REG_LOAD_INT, loc, dest, 0);
+  return dest;
+}
+
+// The register of the variable with the given lexical address, or -1
+// if it is a global variable (in a scope enclosing the call's
+// outermost scope)
+int RegisterCompiler::variable_reg(unsigned depth, unsigned slot) const {
+  if (m_scopes.is_local(depth)) {
+    return int(m_scopes.get_local(depth, slot));
+  }
+  return -1;
+}
+
+bool RegisterCompiler::is_variable(int reg) const {
+  return !(reg & CONSTANT_FLAG) && unsigned(reg) < m_scopes.get_end();
+}
+
+// A scope's variables are allocated above those of the enclosing scope,
+// and any temporaries in use
+void RegisterCompiler::push_scope(unsigned size, unsigned num_defined) {
+  m_scopes.push_at(m_top, size, num_defined);
+  m_top += size;
+  m_out->m_num_regs = std::max(m_out->m_num_regs, m_top);
+}
+
+void RegisterCompiler::pop_scope() {
+  m_top = m_scopes.get_local(0, 0);  // the scope's base
+  m_scopes.pop();
+}
+
+// Compile a statement whose value isn't used
+template<typename NodeRef>
+void RegisterCompiler::compile_statement(NodeRef node) {
+  const Location &loc = node->get_loc();
+
+  switch (node->get_tag()) {
+    case AST_INT_LITERAL:
+      return;
+    case AST_VARDEF: {
+      Symbol var_name = node->get_kid(0)->get_symbol();
+      if (m_scopes.empty()) {
+        emit(REG_DEFINE_GLOBAL, loc, int(var_name), 0, 0, var_name);
+      } else {
+        emit(REG_LOAD_INT, loc, int(m_scopes.define()), 0, 0, var_name);
+      }
+      return;
+    }
+    case AST_STATEMENT:
+      compile_statement(node->get_kid(0));
+      return;
+    case AST_FUNCTION:
+      compile_function_def(node);
+      return;
+    case AST_IF: {
+      unsigned jump_to_else = compile_condition(node->get_kid(0), false, loc);
+      compile_statements(node->get_kid(1), -1, false);
+      if (node->get_num_kids() > 2) {
+        unsigned jump_to_end = emit(REG_JUMP, loc);
+        set_jump_target(jump_to_else, m_out->get_size());
+        compile_statements(node->get_kid(2), -1, false);
+        set_jump_target(jump_to_end, m_out->get_size());
+      } else {
+        set_jump_target(jump_to_else, m_out->get_size());
+      }
+      return;
+    }
+    case AST_WHILE: {
+      // the condition is tested at the bottom of the loop, so each
+      // iteration only needs one jump
+      unsigned jump_to_test = emit(REG_JUMP, loc);
+      unsigned top = m_out->get_size();
+      compile_statements(node->get_kid(1), -1, false);
+      set_jump_target(jump_to_test, m_out->get_size());
+      unsigned jump_to_top = compile_condition(node->get_kid(0), true, loc);
+      set_jump_target(jump_to_top, top);
+      return;
+    }
+    case AST_STATEMENT_LIST:
+      compile_statements(node, -1, false);
+      return;
+    default: {
+      unsigned saved_top = m_top;
+      compile_value(node, -1);
+      m_top = saved_top;
+      return;
+    }
+  }
+}
+
+// Compile the statements of a block, which (like Interpreter::evaluate())
+// only gets a scope of its own if it defines variables.  If keep_value
+// is true, returns the register holding the value of the last statement.
+template<typename NodeRef>
+int RegisterCompiler::compile_statements(NodeRef node, int dest, bool keep_value) {
+  unsigned num_vars = node->get_num_vars();
+  if (num_vars > 0) {
+    push_scope(num_vars);
+  }
+  int result = -1;
+  unsigned num_kids = node->get_num_kids();
+  for (unsigned i = 0; i < num_kids; ++i) {
+    if (keep_value && i == num_kids - 1) {
+      result = compile_value(node->get_kid(i), dest);
+    } else {
+      compile_statement(node->get_kid(i));
+    }
+  }
+  if (keep_value && num_kids == 0) {
+    result = load_zero(dest, node->get_loc());
+  }
+  if (num_vars > 0) {
+    pop_scope();
+  }
+  // the value may be in one of the block's variables, which
+  // must not be reused until the value has been used
+  if (result >= 0 && !(result & CONSTANT_FLAG)) {
+    m_top = std::max(m_top, unsigned(result) + 1);
+  }
+  return result;
+}
+
+// Compile code which evaluates a node, and return the register holding
+// its value.  If dest isn't -1, the value is put in register dest,
+// otherwise it may be left in a variable's register, a constant, or a
+// new temporary.  Temporaries above the one returned may be used and
+// freed.  The code does the same things, in the same order, as
+// Interpreter::evaluate(), so errors are reported in the same way.
+template<typename NodeRef>
+int RegisterCompiler::compile_value(NodeRef node, int dest) {
+  const Location &loc = node->get_loc();
+  switch (node->get_tag()) {
+    case AST_INT_LITERAL:
+      if (dest < 0) {
+        return constant(node->get_int_value());
+      }
+      emit(REG_LOAD_INT, loc, dest, node->get_int_value());
+      return dest;
+    case AST_VARREF: {
+      int var = variable_reg(node->get_depth(), node->get_slot());
+      if (var >= 0) {
+        if (dest < 0 || dest == var) {
+          return var;
+        }
+        emit(REG_MOVE, loc, dest, var, 0, node->get_symbol());
+        return dest;
+      }
+      if (dest < 0) {
+        dest = new_temp();
+      }
+      emit(REG_LOAD_GLOBAL, loc, dest, int(m_scopes.get_global_depth(node->get_depth())), int(node->get_slot()), node->get_symbol());
+      return dest;
+    }
+    case AST_ASSIGN: {
+      NodeRef var_ref_node = node->get_kid(0);
+      int var = variable_reg(var_ref_node->get_depth(), var_ref_node->get_slot());
+      if (var >= 0) {
+        // the value is computed directly into the variable's register
+        compile_value(node->get_kid(1), var);
+        if (dest < 0 || dest == var) {
+          return var;
+        }
+        emit(REG_MOVE, loc, dest, var, 0, var_ref_node->get_symbol());
+        return dest;
+      }
+      int value = compile_value(node->get_kid(1), dest);
+      emit(REG_STORE_GLOBAL, loc, value, int(m_scopes.get_global_depth(var_ref_node->get_depth())), int(var_ref_node->get_slot()), var_ref_node->get_symbol());
+      return value;
+    }
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MULTIPLY:
+    case AST_DIVIDE:
+    case AST_LESS:
+    case AST_LESS_EQUAL:
+    case AST_GREATER:
+    case AST_GREATER_EQUAL:
+    case AST_EQUAL:
+    case AST_NOT_EQUAL: {
+      unsigned saved_top = m_top;
+      int left = compile_operand(node->get_kid(0), node->get_kid(1));
+      int right = compile_value(node->get_kid(1), -1);
+      m_top = saved_top;
+      if (dest < 0) {
+        dest = new_temp();
+      }
+      emit(binary_opcode(node->get_tag()), loc, dest, left, right);
+      return dest;
+    }
+    case AST_LOGICAL_AND:
+    case AST_LOGICAL_OR: {
+      unsigned saved_top = m_top;
+      int result = dest >= 0 ? dest : new_temp();
+      int left = compile_value(node->get_kid(0), -1);
+      unsigned jump = emit(node->get_tag() == AST_LOGICAL_AND ? REG_AND : REG_OR, loc, result, left);
+      int right = compile_value(node->get_kid(1), -1);
+      emit(REG_TO_BOOL, loc, result, right);
+      set_jump_target(jump, m_out->get_size());
+      m_top = dest >= 0 ? saved_top : unsigned(result) + 1;
+      return result;
+    }
+    case AST_STATEMENT:
+      return compile_value(node->get_kid(0), dest);
+    case AST_FNCALL: {
+      // the function and its arguments go in the registers at the top
+      // of the frame, and the result replaces the function
+      unsigned saved_top = m_top;
+      NodeRef func_varref_node = node->get_kid(0);
+      Symbol func_name = func_varref_node->get_symbol();
+      int callee = new_temp();
+      int var = variable_reg(func_varref_node->get_depth(), func_varref_node->get_slot());
+      if (var >= 0) {
+        emit(REG_MOVE, loc, callee, var, 0, func_name);
+      } else {
+        emit(REG_LOAD_GLOBAL_FN, loc, callee, int(m_scopes.get_global_depth(func_varref_node->get_depth())), int(func_varref_node->get_slot()), func_name);
+      }
+      unsigned num_args = 0;
+      if (node->get_num_kids() > 1) {
+        NodeRef arg_list_node = node->get_kid(1);
+        num_args = arg_list_node->get_num_kids();
+        for (unsigned i = 0; i < num_args; ++i) {
+          int arg = new_temp();
+          compile_value(arg_list_node->get_kid(i), arg);
+          m_top = unsigned(arg) + 1;
+        }
+      }
+      emit(REG_CALL, loc, callee, int(num_args), 0, func_name);
+      m_top = unsigned(callee) + 1;
+      if (dest < 0) {
+        return callee;
+      }
+      emit(REG_MOVE, loc, dest, callee);
+      m_top = saved_top;
+      return dest;
+    }
+    case AST_VARDEF:
+    case AST_FUNCTION:
+    case AST_IF:
+    case AST_WHILE:
+      compile_statement(node);
+      return load_zero(dest, loc);
+    case AST_STATEMENT_LIST:
+      return compile_statements(node, dest, true);
+    default:
+      RuntimeError::raise("Unknown AST node type %d during compilation.", node->get_tag());
+  }
+}
+
+// Compile the left operand of a binary operator.  A variable's
+// register can only be used directly if evaluating the right
+// operand (later) can't assign to the variable.
+template<typename NodeRef>
+int RegisterCompiler::compile_operand(NodeRef node, NodeRef later) {
+  int reg = compile_value(node, -1);
+  if (is_variable(reg) && has_assignment(later)) {
+    int temp = new_temp();
+    emit(REG_MOVE, node->get_loc(), temp, reg);
+    return temp;
+  }
+  return reg;
+}
+
+template<typename NodeRef>
+bool RegisterCompiler::has_assignment(NodeRef node) {
+  if (node->get_tag() == AST_ASSIGN) {
+    return true;
+  }
+  for (unsigned i = 0; i < node->get_num_kids(); ++i) {
+    if (has_assignment(node->get_kid(i))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Compile a test of the condition of an if or while statement, and
+// return the jump made if the condition is jump_if, whose target must
+// be set.  A comparison is compiled to a single compare-and-jump
+// instruction.
+template<typename NodeRef>
+unsigned RegisterCompiler::compile_condition(NodeRef cond, bool jump_if, const Location &loc) {
+  unsigned saved_top = m_top;
+  unsigned jump;
+  if (is_comparison(cond->get_tag())) {
+    int left = compile_operand(cond->get_kid(0), cond->get_kid(1));
+    int right = compile_value(cond->get_kid(1), -1);
+    // the comparison's operands are checked where it is
+    jump = emit(jump_opcode(cond->get_tag(), jump_if), cond->get_loc(), left, right);
+  } else {
+    int value = compile_value(cond, -1);
+    jump = emit(jump_if ? REG_JUMP_IF_TRUE : REG_JUMP_IF_FALSE, loc, value);
+  }
+  m_top = saved_top;
+  return jump;
+}
+
+// As with BytecodeCompiler, the Function is created now, and
+// defined when the definition is executed.
+template<typename NodeRef>
+void RegisterCompiler::compile_function_def(NodeRef node) {
+  assert(m_scopes.empty());
+  NodeRef func_name_node = node->get_kid(0);
+  std::vector<Symbol> params;
+  if (node->get_num_kids() > 2) {
+    NodeRef param_list = node->get_kid(1);
+    for (unsigned i = 0; i < param_list->get_num_kids(); ++i) {
+      params.push_back(param_list->get_kid(i)->get_symbol());
+    }
+  }
+  Function *fn = new_function(std::string(func_name_node->get_str()), params, m_globals, node->get_last_kid());
+  m_functions.push_back(Value(fn));
+  emit(REG_DEFINE_FUNCTION, node->get_loc(), int(m_functions.size() - 1), 0, 0, func_name_node->get_symbol());
+}
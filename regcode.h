@@ -0,0 +1,188 @@
+#ifndef REGCODE_H
+#define REGCODE_H
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "symtab.h"
+#include "location.h"
+#include "value.h"
+#include "flat_ast.h"
+#include "dispatch.h"
+#include "local_scopes.h"
+class Node;
+class Environment;
+class Function;
+
+// Three-address instructions for the register machine (see RegisterVM).
+// Each call has a frame of registers: its parameters, followed by the
+// (int) constants used by its code, followed by the variables defined
+// in its blocks, followed by temporaries.  Global variables are
+// addressed as in the global Environment.  Jump targets are always
+// in c.
+enum RegOpcode {
+  REG_MOVE,            // r[a] = r[b]
+  REG_LOAD_INT,        // r[a] = the int b
+  REG_LOAD_GLOBAL,     // r[a] = the global variable with lexical address (b, c)
+  REG_LOAD_GLOBAL_FN,  // the same, for the function being called
+  REG_STORE_GLOBAL,    // the global variable with lexical address (b, c) = r[a]
+  REG_DEFINE_GLOBAL,   // define the global variable named by the Symbol a
+  REG_DEFINE_FUNCTION, // define the global variable for function a of the program
+  REG_ADD,             // r[a] = r[b] + r[c] (and so on)
+  REG_SUB,
+  REG_MULTIPLY,
+  REG_DIVIDE,
+  REG_LESS,            // r[a] = 1 if r[b] < r[c], 0 if not (and so on)
+  REG_LESS_EQUAL,
+  REG_GREATER,
+  REG_GREATER_EQUAL,
+  REG_EQUAL,
+  REG_NOT_EQUAL,
+  REG_AND,             // if r[b] is 0, r[a] = 0 and jump to c
+  REG_OR,              // if r[b] isn't 0, r[a] = 1 and jump to c
+  REG_TO_BOOL,         // r[a] = 1 if r[b] isn't 0, 0 if it is
+  REG_JUMP,            // jump to c
+  REG_JUMP_IF_FALSE,   // jump to c if r[a] is 0
+  REG_JUMP_IF_TRUE,    // jump to c if r[a] isn't 0
+  REG_JLT,             // jump to c if r[a] < r[b] (and so on)
+  REG_JLE,
+  REG_JGT,
+  REG_JGE,
+  REG_JEQ,
+  REG_JNE,
+  REG_CALL,            // call the function in r[a] with the b arguments
+                       // in r[a + 1]..., putting the result in r[a]
+  REG_RETURN,          // return r[a] from the current call
+  REG_NUM_OPCODES
+};
+
+struct RegInstruction {
+  RegOpcode op;
+  int a, b, c;
+#ifdef THREADED_DISPATCH
+  const void *handler;  // the address of the VM's handler for op
+#endif
+};
+
+// The compiled code of a function body, or of the program itself.
+// As with Bytecode, the source location and variable name of each
+// instruction are kept apart from the instructions.
+class RegisterCode {
+private:
+  friend class RegisterCompiler;
+
+  mutable std::vector<RegInstruction> m_code;  // (mutable so it can be threaded)
+  std::vector<Location> m_locs;
+  std::vector<Symbol> m_names;
+  std::vector<Value> m_constants;  // the constants, in registers starting at m_constants_base
+  unsigned m_constants_base;
+  unsigned m_num_regs;             // number of registers in a frame
+#ifdef THREADED_DISPATCH
+  mutable bool m_threaded;
+#endif
+
+  // value semantics prohibited
+  RegisterCode(const RegisterCode &);
+  RegisterCode &operator=(const RegisterCode &);
+
+public:
+  RegisterCode();
+
+  const RegInstruction *get_code() const { return m_code.data(); }
+  unsigned get_size() const { return unsigned(m_code.size()); }
+  const Location &get_loc(unsigned pc) const { return m_locs[pc]; }
+  Symbol get_name(unsigned pc) const { return m_names[pc]; }
+  unsigned get_num_regs() const { return m_num_regs; }
+  const std::vector<Value> &get_constants() const { return m_constants; }
+  unsigned get_constants_base() const { return m_constants_base; }
+
+#ifdef THREADED_DISPATCH
+  // Set the handler of each instruction, from a table of the handlers
+  // for each opcode.
+  bool is_threaded() const { return m_threaded; }
+  void thread(const void *const handlers[]) const;
+#endif
+};
+
+// Compiles an analyzed AST (see Interpreter::analyze()) to RegisterCode.
+// Like BytecodeCompiler, the program is compiled by compile_program(),
+// and each function is compiled when it is first called.
+//
+// Registers are allocated like a stack: a block's variables are
+// allocated when the block is entered, and an expression's temporaries
+// above those, so that the arguments of a call are in the registers
+// at the top of the frame, where they become the parameters of the
+// function called.  A variable's register is used directly as an
+// operand (or as the destination of an assignment), rather than being
+// copied to a temporary.
+class RegisterCompiler {
+private:
+  // Until the number of constants is known, the registers following
+  // the parameters are numbered as if there were none, and constant k
+  // is referred to as register CONSTANT_FLAG | k
+  enum { CONSTANT_FLAG = 1 << 30 };
+
+  Environment *m_globals;
+  std::vector<std::unique_ptr<RegisterCode>> m_compiled;
+  std::vector<Value> m_functions;  // the program's functions
+
+  // state while compiling one RegisterCode
+  RegisterCode *m_out;
+  LocalScopes m_scopes;            // scopes enclosed by the global scope
+  unsigned m_top;                  // the first free register
+  unsigned m_num_params;
+  std::unordered_map<int, unsigned> m_constant_index;
+
+  // value semantics prohibited
+  RegisterCompiler(const RegisterCompiler &);
+  RegisterCompiler &operator=(const RegisterCompiler &);
+
+public:
+  // Functions defined by the program are defined in the given
+  // global environment, which is where the program is executed.
+  RegisterCompiler(Environment *globals);
+  ~RegisterCompiler();
+
+  const RegisterCode *compile_program(Node *unit);
+  const RegisterCode *compile_program(FlatNode unit);
+
+  // Compile the body of a function, which must have been analyzed.
+  const RegisterCode *compile_function(Function *fn);
+
+  // Get the Function value for function a of REG_DEFINE_FUNCTION.
+  const Value &get_function(unsigned index) const { return m_functions[index]; }
+
+private:
+  template<typename NodeRef>
+  void compile_unit(NodeRef unit);
+  template<typename NodeRef>
+  void compile_body(NodeRef body, unsigned num_params);
+  template<typename NodeRef>
+  void compile_statement(NodeRef node);
+  template<typename NodeRef>
+  int compile_statements(NodeRef node, int dest, bool keep_value);
+  template<typename NodeRef>
+  int compile_value(NodeRef node, int dest);
+  template<typename NodeRef>
+  int compile_operand(NodeRef node, NodeRef later);
+  template<typename NodeRef>
+  unsigned compile_condition(NodeRef cond, bool jump_if, const Location &loc);
+  template<typename NodeRef>
+  void compile_function_def(NodeRef node);
+  template<typename NodeRef>
+  static bool has_assignment(NodeRef node);
+
+  void start(RegisterCode *out, unsigned num_params);
+  void finish();
+  unsigned emit(RegOpcode op, const Location &loc, int a = 0, int b = 0, int c = 0, Symbol name = NO_SYMBOL);
+  void set_jump_target(unsigned pc, unsigned target);
+  int new_temp();
+  int constant(int value);
+  int load_zero(int dest, const Location &loc);
+  int variable_reg(unsigned depth, unsigned slot) const;
+  bool is_variable(int reg) const;
+  void push_scope(unsigned size, unsigned num_defined = 0);
+  void pop_scope();
+};
+
+#endif // REGCODE_H
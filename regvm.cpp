@@ -0,0 +1,248 @@
+#include <algorithm>
+#include "ast.h"
+#include "node.h"
+#include "exceptions.h"
+#include "environment.h"
+#include "function.h"
+#include "regcode.h"
+#include "interp.h"
+#include "stats.h"
+#include "binary_op.h"
+#include "dispatch.h"
+#include "regvm.h"
+
+namespace {
+
+// Initial size of the stack (in Values), which is enough for
+// most programs
+const size_t INITIAL_STACK_SIZE = 4096;
+
+}
+
+RegisterVM::RegisterVM(Interpreter *interp, RegisterCompiler *compiler, Environment *globals)
+  : m_interp(interp)
+  , m_compiler(compiler)
+  , m_globals(globals)
+#ifdef THREADED_DISPATCH
+  , m_handlers(nullptr)
+#endif
+{
+}
+
+RegisterVM::~RegisterVM() {
+}
+
+// Make a frame for code starting at the given stack index (which may
+// move the stack), load its constants, and return its register 0.
+// Code is threaded when it is first executed.
+Value *RegisterVM::enter(const RegisterCode *code, size_t base) {
+  size_t size = base + code->get_num_regs();
+  if (size > m_stack.size()) {
+    m_stack.resize(std::max(size, std::max(2 * m_stack.size(), INITIAL_STACK_SIZE)));
+  }
+  Value *regs = m_stack.data() + base;
+#ifdef THREADED_DISPATCH
+  if (!code->is_threaded()) {
+    code->thread(m_handlers);
+  }
+#endif
+  const std::vector<Value> &constants = code->get_constants();
+  std::copy(constants.begin(), constants.end(), regs + code->get_constants_base());
+  return regs;
+}
+
+Value RegisterVM::execute(const RegisterCode *program) {
+#ifdef THREADED_DISPATCH
+  static const void *const handlers[] = {
+    HANDLER_ADDRESS(REG_MOVE), HANDLER_ADDRESS(REG_LOAD_INT),
+    HANDLER_ADDRESS(REG_LOAD_GLOBAL), HANDLER_ADDRESS(REG_LOAD_GLOBAL_FN),
+    HANDLER_ADDRESS(REG_STORE_GLOBAL), HANDLER_ADDRESS(REG_DEFINE_GLOBAL),
+    HANDLER_ADDRESS(REG_DEFINE_FUNCTION), HANDLER_ADDRESS(REG_ADD),
+    HANDLER_ADDRESS(REG_SUB), HANDLER_ADDRESS(REG_MULTIPLY),
+    HANDLER_ADDRESS(REG_DIVIDE), HANDLER_ADDRESS(REG_LESS),
+    HANDLER_ADDRESS(REG_LESS_EQUAL), HANDLER_ADDRESS(REG_GREATER),
+    HANDLER_ADDRESS(REG_GREATER_EQUAL), HANDLER_ADDRESS(REG_EQUAL),
+    HANDLER_ADDRESS(REG_NOT_EQUAL), HANDLER_ADDRESS(REG_AND),
+    HANDLER_ADDRESS(REG_OR), HANDLER_ADDRESS(REG_TO_BOOL),
+    HANDLER_ADDRESS(REG_JUMP), HANDLER_ADDRESS(REG_JUMP_IF_FALSE),
+    HANDLER_ADDRESS(REG_JUMP_IF_TRUE), HANDLER_ADDRESS(REG_JLT),
+    HANDLER_ADDRESS(REG_JLE), HANDLER_ADDRESS(REG_JGT),
+    HANDLER_ADDRESS(REG_JGE), HANDLER_ADDRESS(REG_JEQ),
+    HANDLER_ADDRESS(REG_JNE), HANDLER_ADDRESS(REG_CALL),
+    HANDLER_ADDRESS(REG_RETURN),
+  };
+  static_assert(sizeof(handlers) / sizeof(handlers[0]) == REG_NUM_OPCODES, "a handler is missing");
+  m_handlers = handlers;
+#endif
+
+  const RegisterCode *code = program;
+  const RegInstruction *ip = code->get_code();
+  const RegInstruction *ins;
+  Value *r = enter(code, 0);
+  unsigned long num_executed = 0;
+
+// the index of the instruction being executed
+#define PC unsigned(ip - 1 - code->get_code())
+
+// a binary operator (see BinaryOp) on registers b and c
+#define BINARY_OP(tag) \
+  r[ins->a] = apply_binary_op<BinaryOp<tag>>(r[ins->b], r[ins->c], code->get_loc(PC)); \
+  DISPATCH()
+
+// a compare-and-jump instruction
+#define COMPARE_AND_JUMP(tag) \
+  if (apply_binary_op<BinaryOp<tag>>(r[ins->a], r[ins->b], code->get_loc(PC)).get_ival()) { \
+    ip = code->get_code() + ins->c; \
+  } \
+  DISPATCH()
+
+#ifdef THREADED_DISPATCH
+  DISPATCH();
+#else
+  while (true) {
+    ins = ip++;
+    num_executed++;
+    switch (ins->op) {
+#endif
+      HANDLER(REG_MOVE)
+        r[ins->a] = r[ins->b];
+        DISPATCH();
+      HANDLER(REG_LOAD_INT)
+        r[ins->a] = Value(ins->b);
+        DISPATCH();
+      HANDLER(REG_LOAD_GLOBAL)
+      HANDLER(REG_LOAD_GLOBAL_FN) {
+        Value *var = m_globals->get_slot(unsigned(ins->b), unsigned(ins->c));
+        if (var == nullptr) {
+          if (ins->op == REG_LOAD_GLOBAL_FN) {
+            RuntimeError::raise("Undefined variable: '%s'", SymbolTable::get_name(code->get_name(PC)).c_str());
+          }
+          RuntimeError::raise("Undefined variable '%s' during execution.", SymbolTable::get_name(code->get_name(PC)).c_str());
+        }
+        r[ins->a] = *var;
+        DISPATCH();
+      }
+      HANDLER(REG_STORE_GLOBAL) {
+        Value *var = m_globals->get_slot(unsigned(ins->b), unsigned(ins->c));
+        if (var == nullptr) {
+          SemanticError::raise(code->get_loc(PC), "Assignment to undefined variable '%s'.", SymbolTable::get_name(code->get_name(PC)).c_str());
+        }
+        *var = r[ins->a];
+        DISPATCH();
+      }
+      HANDLER(REG_DEFINE_GLOBAL)
+        if (!m_globals->define_variable(Symbol(ins->a), Value(0))) {
+          EvaluationError::raise(code->get_loc(PC), "Variable '%s' already defined in this scope.", SymbolTable::get_name(Symbol(ins->a)).c_str());
+        }
+        DISPATCH();
+      HANDLER(REG_DEFINE_FUNCTION)
+        if (!m_globals->define_variable(code->get_name(PC), m_compiler->get_function(unsigned(ins->a)))) {
+          EvaluationError::raise(code->get_loc(PC), "Variable '%s' already defined in this scope.", SymbolTable::get_name(code->get_name(PC)).c_str());
+        }
+        DISPATCH();
+      HANDLER(REG_ADD)
+        BINARY_OP(AST_ADD);
+      HANDLER(REG_SUB)
+        BINARY_OP(AST_SUB);
+      HANDLER(REG_MULTIPLY)
+        BINARY_OP(AST_MULTIPLY);
+      HANDLER(REG_DIVIDE)
+        BINARY_OP(AST_DIVIDE);
+      HANDLER(REG_LESS)
+        BINARY_OP(AST_LESS);
+      HANDLER(REG_LESS_EQUAL)
+        BINARY_OP(AST_LESS_EQUAL);
+      HANDLER(REG_GREATER)
+        BINARY_OP(AST_GREATER);
+      HANDLER(REG_GREATER_EQUAL)
+        BINARY_OP(AST_GREATER_EQUAL);
+      HANDLER(REG_EQUAL)
+        BINARY_OP(AST_EQUAL);
+      HANDLER(REG_NOT_EQUAL)
+        BINARY_OP(AST_NOT_EQUAL);
+      HANDLER(REG_AND)
+      HANDLER(REG_OR)
+      HANDLER(REG_TO_BOOL) {
+        const Value &val = r[ins->b];
+        if (!val.is_int()) {
+          EvaluationError::raise(code->get_loc(PC), "Operand must be an integer.");
+        }
+        bool is_true = val.get_ival() != 0;
+        if (ins->op == REG_TO_BOOL) {
+          r[ins->a] = Value(is_true ? 1 : 0);
+        } else if (is_true == (ins->op == REG_OR)) {
+          // short-circuit
+          r[ins->a] = Value(is_true ? 1 : 0);
+          ip = code->get_code() + ins->c;
+        }
+        DISPATCH();
+      }
+      HANDLER(REG_JUMP)
+        ip = code->get_code() + ins->c;
+        DISPATCH();
+      HANDLER(REG_JUMP_IF_FALSE)
+      HANDLER(REG_JUMP_IF_TRUE) {
+        const Value &cond = r[ins->a];
+        if (!cond.is_int()) {
+          EvaluationError::raise(code->get_loc(PC), "Condition must evaluate to an integer");
+        }
+        if ((cond.get_ival() != 0) == (ins->op == REG_JUMP_IF_TRUE)) {
+          ip = code->get_code() + ins->c;
+        }
+        DISPATCH();
+      }
+      HANDLER(REG_JLT)
+        COMPARE_AND_JUMP(AST_LESS);
+      HANDLER(REG_JLE)
+        COMPARE_AND_JUMP(AST_LESS_EQUAL);
+      HANDLER(REG_JGT)
+        COMPARE_AND_JUMP(AST_GREATER);
+      HANDLER(REG_JGE)
+        COMPARE_AND_JUMP(AST_GREATER_EQUAL);
+      HANDLER(REG_JEQ)
+        COMPARE_AND_JUMP(AST_EQUAL);
+      HANDLER(REG_JNE)
+        COMPARE_AND_JUMP(AST_NOT_EQUAL);
+      HANDLER(REG_CALL) {
+        unsigned num_args = unsigned(ins->b);
+        Value *callee = r + ins->a;
+        if (callee->is_intrinsic_fn()) {
+          *callee = callee->get_intrinsic_fn()(callee + 1, num_args, code->get_loc(PC), m_interp);
+          DISPATCH();
+        }
+
+        // the arguments become the first registers of the call
+        const RegisterCode *fn_code = m_compiler->compile_function(m_interp->check_call(*callee, num_args, code->get_loc(PC), code->get_name(PC)));
+        Interpreter::check_call_depth(m_frames.size());
+        m_frames.push_back({ code, unsigned(ip - code->get_code()), size_t(r - m_stack.data()) });
+        code = fn_code;
+        ip = code->get_code();
+        r = enter(code, size_t(callee + 1 - m_stack.data()));
+        DISPATCH();
+      }
+      HANDLER(REG_RETURN) {
+        Value result = r[ins->a];
+        if (m_frames.empty()) {
+          Stats::instructions_executed += num_executed;
+          return result;
+        }
+        // the result replaces the function that was called
+        r[-1] = result;
+        const Frame &caller = m_frames.back();
+        code = caller.code;
+        ip = code->get_code() + caller.pc;
+        r = m_stack.data() + caller.base;
+        m_frames.pop_back();
+        DISPATCH();
+      }
+#ifndef THREADED_DISPATCH
+      default:
+        RuntimeError::raise("Unknown opcode %d.", int(ins->op));
+    }
+  }
+#endif
+
+#undef BINARY_OP
+#undef COMPARE_AND_JUMP
+#undef PC
+}
@@ -0,0 +1,54 @@
+#ifndef REGVM_H
+#define REGVM_H
+
+#include <vector>
+#include "value.h"
+#include "dispatch.h"
+class RegisterCode;
+class RegisterCompiler;
+class Environment;
+class Interpreter;
+
+// A virtual machine which executes RegisterCode.  The register frames
+// of the calls in progress are kept on one stack of Values: a call's
+// frame starts just above the register of the caller which holds the
+// function being called, so the arguments the caller put in the
+// registers above that become the call's first registers.  As in VM,
+// calls don't use the native stack, and the depth of recursion is
+// limited to Interpreter::MAX_CALL_DEPTH.
+class RegisterVM {
+private:
+  // a call which is waiting for a call it made to return
+  struct Frame {
+    const RegisterCode *code;
+    unsigned pc;      // where to continue
+    size_t base;      // stack index of the call's register 0
+  };
+
+  Interpreter *m_interp;
+  RegisterCompiler *m_compiler;
+  Environment *m_globals;
+  std::vector<Value> m_stack;
+  std::vector<Frame> m_frames;
+#ifdef THREADED_DISPATCH
+  const void *const *m_handlers;  // the handler for each opcode
+#endif
+
+  // value semantics prohibited
+  RegisterVM(const RegisterVM &);
+  RegisterVM &operator=(const RegisterVM &);
+
+public:
+  // Lazily-parsed function bodies are analyzed by the interpreter, and
+  // functions are compiled by the compiler, when they're first called.
+  RegisterVM(Interpreter *interp, RegisterCompiler *compiler, Environment *globals);
+  ~RegisterVM();
+
+  // Execute the program, returning its result.
+  Value execute(const RegisterCode *program);
+
+private:
+  Value *enter(const RegisterCode *code, size_t base);
+};
+
+#endif // REGVM_H
@@ -0,0 +1,65 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <cassert>
+
+// A FIFO queue with a fixed capacity N, stored inline, so that
+// pushing and popping never allocate memory.  N must be a power of 2
+// (so that indices can wrap with a mask rather than a division).
+
+template<typename T, unsigned N>
+class RingBuffer {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "RingBuffer capacity must be a power of 2");
+
+private:
+  T m_items[N];
+  unsigned m_head, m_count;
+
+public:
+  RingBuffer() : m_head(0), m_count(0) { }
+
+  static constexpr unsigned capacity() { return N; }
+
+  unsigned size() const { return m_count; }
+  bool empty() const { return m_count == 0; }
+  bool full() const { return m_count == N; }
+
+  // Get the element at given index (0 is the front)
+  T &operator[](unsigned index) {
+    assert(index < m_count);
+    return m_items[(m_head + index) & (N - 1)];
+  }
+
+  const T &operator[](unsigned index) const {
+    assert(index < m_count);
+    return m_items[(m_head + index) & (N - 1)];
+  }
+
+  // Get the (uninitialized) slot past the back of the queue,
+  // so that an element can be constructed in place before
+  // calling push_back_slot()
+  T &back_slot() {
+    assert(!full());
+    return m_items[(m_head + m_count) & (N - 1)];
+  }
+
+  void push_back_slot() {
+    assert(!full());
+    m_count++;
+  }
+
+  void push_back(const T &item) {
+    back_slot() = item;
+    push_back_slot();
+  }
+
+  T pop_front() {
+    assert(!empty());
+    T item = m_items[m_head];
+    m_head = (m_head + 1) & (N - 1);
+    m_count--;
+    return item;
+  }
+};
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,112 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <climits>
+#include "exceptions.h"
+#include "source_buffer.h"
+
+namespace {
+
+// Size of the reads used when the input can't be mapped
+const size_t READ_BLOCK_SIZE = 1 << 20;
+
+std::vector<std::unique_ptr<SourceBuffer>> s_files;
+
+}
+
+SourceBuffer::SourceBuffer(FILE *in, const std::string &filename)
+  : m_filename(filename)
+  , m_data(nullptr)
+  , m_size(0)
+  , m_map(nullptr) {
+  if (!try_map(in)) {
+    read_blocks(in);
+  }
+}
+
+SourceBuffer::~SourceBuffer() {
+  if (m_map != nullptr) {
+    munmap(m_map, m_size);
+  }
+}
+
+// Map the file into memory if it is a (nonempty) regular file.
+// Returns false if the caller should fall back on read_blocks().
+bool SourceBuffer::try_map(FILE *in) {
+  int fd = fileno(in);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    return false;
+  }
+
+  // mmap() ignores the FILE's buffer, so this is only safe
+  // if nothing has been read through the FILE yet
+  if (ftell(in) != 0) {
+    return false;
+  }
+
+  size_t size = size_t(st.st_size);
+  void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  m_map = map;
+  m_data = static_cast<const char *>(map);
+  m_size = size;
+  return true;
+}
+
+void SourceBuffer::read_blocks(FILE *in) {
+  for (;;) {
+    size_t used = m_heap.size();
+    m_heap.resize(used + READ_BLOCK_SIZE);
+    size_t n = fread(m_heap.data() + used, 1, READ_BLOCK_SIZE, in);
+    m_heap.resize(used + n);
+    if (n < READ_BLOCK_SIZE) {
+      break;
+    }
+  }
+  if (ferror(in)) {
+    RuntimeError::raise("Error reading input file '%s'", m_filename.c_str());
+  }
+
+  m_data = m_heap.data();
+  m_size = m_heap.size();
+}
+
+void SourceBuffer::get_line_col(size_t offset, int &line, int &col) const {
+  if (m_line_starts.empty()) {
+    m_line_starts.push_back(0);
+    const char *p = m_data, *end = m_data + m_size;
+    while ((p = static_cast<const char *>(memchr(p, '\n', size_t(end - p)))) != nullptr) {
+      ++p;
+      m_line_starts.push_back(size_t(p - m_data));
+    }
+  }
+
+  // find the last line starting at or before offset
+  auto i = std::upper_bound(m_line_starts.begin(), m_line_starts.end(), offset) - 1;
+  line = int(i - m_line_starts.begin()) + 1;
+  col = int(offset - *i) + 1;
+}
+
+////////////////////////////////////////////////////////////////////////
+// SourceFileTable implementation
+////////////////////////////////////////////////////////////////////////
+
+unsigned SourceFileTable::add(std::unique_ptr<SourceBuffer> buf) {
+  if (buf->size() >= UINT_MAX) {
+    RuntimeError::raise("Input file '%s' is too large", buf->get_filename().c_str());
+  }
+  s_files.push_back(std::move(buf));
+  return unsigned(s_files.size() - 1);
+}
+
+const SourceBuffer &SourceFileTable::get(unsigned file_id) {
+  assert(file_id < s_files.size());
+  return *s_files[file_id];
+}
@@ -0,0 +1,73 @@
+#ifndef SOURCE_BUFFER_H
+#define SOURCE_BUFFER_H
+
+#include <cstdio>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A SourceBuffer holds the complete text of one input file in
+// contiguous memory, so that the Lexer can scan it with plain
+// pointer arithmetic rather than one stdio call per character.
+// Regular files are mapped into memory with mmap(); anything that
+// can't be mapped (pipes, terminals, <stdin>) is read in large blocks.
+// Note that the text is *not* NUL-terminated: use end() to
+// detect the end of input.
+
+class SourceBuffer {
+private:
+  std::string m_filename;
+  const char *m_data;
+  size_t m_size;
+  void *m_map;               // non-null if the text is mmap()ed
+  std::vector<char> m_heap;  // holds the text if it was read in blocks
+
+  // offsets of the beginnings of lines, computed the first
+  // time get_line_col() is called
+  mutable std::vector<size_t> m_line_starts;
+
+  // value semantics prohibited
+  SourceBuffer(const SourceBuffer &);
+  SourceBuffer &operator=(const SourceBuffer &);
+
+public:
+  // Load the entire contents of the given (open) file.
+  // The FILE is not closed.
+  SourceBuffer(FILE *in, const std::string &filename);
+  ~SourceBuffer();
+
+  const std::string &get_filename() const { return m_filename; }
+
+  const char *begin() const { return m_data; }
+  const char *end() const { return m_data + m_size; }
+  size_t size() const { return m_size; }
+
+  bool is_mapped() const { return m_map != nullptr; }
+
+  // Translate an offset in the text to a (1-based) line and column.
+  // The first call scans the whole text, so this is meant for
+  // diagnostics, not for use while lexing.
+  void get_line_col(size_t offset, int &line, int &col) const;
+
+private:
+  bool try_map(FILE *in);
+  void read_blocks(FILE *in);
+};
+
+// The SourceFileTable owns the SourceBuffers of all of the files read
+// by the program, and identifies each by a small integer id.  Source
+// text lives as long as the process, so a source position can be
+// represented as just a file id and an offset (see Location).
+class SourceFileTable {
+public:
+  // Take ownership of a SourceBuffer, and return its file id.
+  // Throws RuntimeError if the text is too large for Location
+  // to represent offsets within it.
+  static unsigned add(std::unique_ptr<SourceBuffer> buf);
+
+  // Get the SourceBuffer with the given file id.
+  static const SourceBuffer &get(unsigned file_id);
+};
+
+#endif // SOURCE_BUFFER_H
@@ -0,0 +1,26 @@
+#include "stats.h"
+
+unsigned long Stats::lazy_bodies;
+unsigned long Stats::lazy_bodies_parsed;
+unsigned long Stats::ast_cache_hits;
+unsigned long Stats::ast_cache_misses;
+unsigned long Stats::name_lookups;
+unsigned long Stats::name_lookup_hops;
+unsigned long Stats::slot_lookups;
+unsigned long Stats::slot_lookup_hops;
+unsigned long Stats::nodes_evaluated;
+unsigned long Stats::instructions_executed;
+unsigned long Stats::nodes_quickened;
+unsigned long Stats::nodes_despecialized;
+
+void Stats::print(FILE *out) {
+  fprintf(out, "lazy function bodies: %lu deferred, %lu parsed, %lu never parsed\n",
+          lazy_bodies, lazy_bodies_parsed, lazy_bodies - lazy_bodies_parsed);
+  fprintf(out, "AST cache: %lu hits, %lu misses\n", ast_cache_hits, ast_cache_misses);
+  fprintf(out, "variable lookups: %lu by name (%lu scope hops), %lu by address (%lu scope hops)\n",
+          name_lookups, name_lookup_hops, slot_lookups, slot_lookup_hops);
+  fprintf(out, "execution: %lu AST nodes evaluated, %lu instructions executed\n",
+          nodes_evaluated, instructions_executed);
+  fprintf(out, "quickening: %lu nodes specialized, %lu de-specialized\n",
+          nodes_quickened, nodes_despecialized);
+}
@@ -0,0 +1,46 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdio>
+
+// Counters describing the work done during a run, which can be
+// printed when the run is finished (minilang -s).  Updating a
+// counter is just an increment, so they are always maintained.
+class Stats {
+public:
+  // function bodies whose parsing was deferred (Parser2::set_lazy_function_bodies())
+  static unsigned long lazy_bodies;
+
+  // deferred function bodies that were parsed when first called
+  static unsigned long lazy_bodies_parsed;
+
+  // ASTs loaded from cache files, and cache files that were missing or
+  // out of date (see ASTCache)
+  static unsigned long ast_cache_hits;
+  static unsigned long ast_cache_misses;
+
+  // variables looked up by name, and the number of enclosing scopes
+  // searched to find them (see Environment::lookup())
+  static unsigned long name_lookups;
+  static unsigned long name_lookup_hops;
+
+  // variables accessed by lexical address, and the number of enclosing
+  // scopes stepped out to (see Environment::get_slot())
+  static unsigned long slot_lookups;
+  static unsigned long slot_lookup_hops;
+
+  // AST nodes evaluated by Interpreter::evaluate(), and instructions
+  // executed by the virtual machines (VM and RegisterVM)
+  static unsigned long nodes_evaluated;
+  static unsigned long instructions_executed;
+
+  // binary operator nodes specialized for int operands by
+  // Interpreter::evaluate(), and specialized nodes which were later
+  // returned to the generic variant of their operator
+  static unsigned long nodes_quickened;
+  static unsigned long nodes_despecialized;
+
+  static void print(FILE *out);
+};
+
+#endif // STATS_H
@@ -0,0 +1,172 @@
+#ifndef SYMBOL_MAP_H
+#define SYMBOL_MAP_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include "symtab.h"
+#include "exceptions.h"
+
+// A map from Symbols to values of type T, tuned for maps with only a
+// few entries (such as the variables of one scope).  The entries are
+// kept in one array in the order they were inserted, so each has a
+// fixed index, and the first N of them are stored in the map itself,
+// so a map with no more than N entries doesn't allocate any memory.
+// A small map is searched linearly; once there are more than N
+// entries, an open-addressing hash table (with linear probing) of
+// entry indices is used to find keys.  Entries can't be removed.
+template<typename T, unsigned N = 8>
+class SymbolMap {
+private:
+  struct Entry {
+    Symbol key;
+    T value;
+  };
+
+  Entry *m_entries;       // the inline entries, or a heap-allocated array
+  unsigned m_size, m_capacity;
+  unsigned *m_table;      // hash table of entry index + 1 (0 if empty), if m_size > N
+  unsigned m_table_mask;
+  alignas(Entry) unsigned char m_inline[N * sizeof(Entry)];
+
+  // value semantics prohibited
+  SymbolMap(const SymbolMap &);
+  SymbolMap &operator=(const SymbolMap &);
+
+public:
+  SymbolMap()
+    : m_entries(reinterpret_cast<Entry *>(m_inline))
+    , m_size(0)
+    , m_capacity(N)
+    , m_table(nullptr)
+    , m_table_mask(0) {
+  }
+
+  ~SymbolMap() {
+    for (unsigned i = 0; i < m_size; i++) {
+      m_entries[i].~Entry();
+    }
+    if (m_entries != reinterpret_cast<Entry *>(m_inline)) {
+      free(m_entries);
+    }
+    free(m_table);
+  }
+
+  unsigned size() const { return m_size; }
+
+  // Remove all of the entries, keeping any memory allocated for them.
+  void clear() {
+    for (unsigned i = 0; i < m_size; i++) {
+      m_entries[i].~Entry();
+    }
+    m_size = 0;
+    if (m_table != nullptr) {
+      memset(m_table, 0, (m_table_mask + 1) * sizeof(unsigned));
+    }
+  }
+
+  Symbol key_at(unsigned index) const { assert(index < m_size); return m_entries[index].key; }
+  T &value_at(unsigned index) { assert(index < m_size); return m_entries[index].value; }
+  const T &value_at(unsigned index) const { assert(index < m_size); return m_entries[index].value; }
+
+  // Get the index of the entry with the given key, or -1 if there is none.
+  int find(Symbol key) const {
+    if (m_table == nullptr) {
+      for (unsigned i = 0; i < m_size; i++) {
+        if (m_entries[i].key == key) {
+          return int(i);
+        }
+      }
+      return -1;
+    }
+    for (unsigned h = hash(key) & m_table_mask; m_table[h] != 0; h = (h + 1) & m_table_mask) {
+      if (m_entries[m_table[h] - 1].key == key) {
+        return int(m_table[h] - 1);
+      }
+    }
+    return -1;
+  }
+
+  // Insert an entry, if there isn't already one with the given key.
+  // Returns the index of the entry with the key, and whether it was inserted.
+  std::pair<unsigned, bool> insert(Symbol key, const T &value) {
+    int existing = find(key);
+    if (existing >= 0) {
+      return std::make_pair(unsigned(existing), false);
+    }
+    if (m_size == m_capacity) {
+      grow();
+    }
+    unsigned index = m_size;
+    ::new (&m_entries[index]) Entry{ key, value };
+    m_size++;
+
+    if (m_table != nullptr) {
+      if (m_size * 2 > m_table_mask + 1) {
+        rebuild_table();
+      } else {
+        add_to_table(index);
+      }
+    } else if (m_size > N) {
+      rebuild_table();
+    }
+    return std::make_pair(index, true);
+  }
+
+private:
+  static unsigned hash(Symbol key) {
+    // Symbols are small consecutive integers, so they are mixed
+    // to spread them out over the table
+    uint32_t h = key * 0x9e3779b1u;
+    return h ^ (h >> 16);
+  }
+
+  void grow() {
+    unsigned capacity = m_capacity * 2;
+    Entry *entries = static_cast<Entry *>(malloc(capacity * sizeof(Entry)));
+    if (entries == nullptr) {
+      RuntimeError::raise("Out of memory");
+    }
+    for (unsigned i = 0; i < m_size; i++) {
+      ::new (&entries[i]) Entry{ m_entries[i].key, std::move(m_entries[i].value) };
+      m_entries[i].~Entry();
+    }
+    if (m_entries != reinterpret_cast<Entry *>(m_inline)) {
+      free(m_entries);
+    }
+    m_entries = entries;
+    m_capacity = capacity;
+  }
+
+  // Make a table which is at most a quarter full (it is rebuilt
+  // when it is half full), and add all of the entries
+  void rebuild_table() {
+    unsigned table_size = 4 * N;
+    while (table_size < m_size * 4) {
+      table_size *= 2;
+    }
+    unsigned *table = static_cast<unsigned *>(calloc(table_size, sizeof(unsigned)));
+    if (table == nullptr) {
+      RuntimeError::raise("Out of memory");
+    }
+    free(m_table);
+    m_table = table;
+    m_table_mask = table_size - 1;
+    for (unsigned i = 0; i < m_size; i++) {
+      add_to_table(i);
+    }
+  }
+
+  void add_to_table(unsigned index) {
+    unsigned h = hash(m_entries[index].key) & m_table_mask;
+    while (m_table[h] != 0) {
+      h = (h + 1) & m_table_mask;
+    }
+    m_table[h] = index + 1;
+  }
+};
+
+#endif // SYMBOL_MAP_H
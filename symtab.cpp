@@ -0,0 +1,62 @@
+#include <cassert>
+#include <deque>
+#include "symtab.h"
+
+namespace {
+
+struct Interner {
+  // Names are stored in a deque so that the string_view keys
+  // of the index remain valid as more names are added
+  std::deque<std::string> names;
+  std::unordered_map<std::string_view, Symbol> index;
+};
+
+Interner &get_interner() {
+  static Interner interner;
+  return interner;
+}
+
+}
+
+Symbol SymbolTable::intern(const char *s, size_t len) {
+  Interner &interner = get_interner();
+
+  auto i = interner.index.find(std::string_view(s, len));
+  if (i != interner.index.end()) {
+    return i->second;
+  }
+
+  Symbol sym = Symbol(interner.names.size());
+  interner.names.emplace_back(s, len);
+  interner.index.emplace(interner.names.back(), sym);
+  return sym;
+}
+
+const std::string &SymbolTable::get_name(Symbol sym) {
+  Interner &interner = get_interner();
+  assert(sym < interner.names.size());
+  return interner.names[sym];
+}
+
+unsigned SymbolTable::get_num_symbols() {
+  return unsigned(get_interner().names.size());
+}
+
+LocalSymbolTable::LocalSymbolTable() {
+}
+
+LocalSymbolTable::~LocalSymbolTable() {
+}
+
+unsigned LocalSymbolTable::intern(const char *s, size_t len) {
+  std::string_view name(s, len);
+  auto i = m_index.find(name);
+  if (i != m_index.end()) {
+    return i->second;
+  }
+
+  unsigned id = unsigned(m_names.size());
+  m_names.push_back(name);
+  m_index.emplace(name, id);
+  return id;
+}
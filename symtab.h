@@ -0,0 +1,55 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A Symbol is a dense integer id for an identifier.  Identifiers are
+// interned once (by the lexer), and from then on the parser, the
+// AST, and the interpreter refer to them by Symbol, so comparing
+// or looking up an identifier never requires a string comparison.
+
+typedef unsigned Symbol;
+
+// Symbol value meaning "not an identifier"
+const Symbol NO_SYMBOL = ~0u;
+
+class SymbolTable {
+public:
+  // Get the Symbol for an identifier, assigning the next unused
+  // id if the identifier hasn't been seen before.
+  static Symbol intern(const char *s, size_t len);
+  static Symbol intern(const std::string &s) { return intern(s.data(), s.size()); }
+
+  // Get the name of an interned Symbol.
+  static const std::string &get_name(Symbol sym);
+
+  // Get the number of distinct Symbols interned so far
+  // (all Symbols are less than this value).
+  static unsigned get_num_symbols();
+};
+
+// SymbolTable is not thread safe, so threads that tokenize chunks
+// of the input in parallel each intern identifiers in their own
+// LocalSymbolTable.  Local ids are translated to Symbols (by
+// interning each distinct name once) after the thread has finished.
+// The names are views of the source text, which must outlive the table.
+class LocalSymbolTable {
+private:
+  std::unordered_map<std::string_view, unsigned> m_index;
+  std::vector<std::string_view> m_names;
+
+public:
+  LocalSymbolTable();
+  ~LocalSymbolTable();
+
+  unsigned intern(const char *s, size_t len);
+
+  unsigned get_num_symbols() const { return unsigned(m_names.size()); }
+  std::string_view get_name(unsigned id) const { return m_names[id]; }
+};
+
+#endif // SYMTAB_H
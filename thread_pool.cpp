@@ -0,0 +1,58 @@
+#include <cassert>
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned num_threads)
+  : m_num_pending(0)
+  , m_shutdown(false) {
+  assert(num_threads > 0);
+  for (unsigned i = 0; i < num_threads; i++) {
+    m_workers.emplace_back(&ThreadPool::worker, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_shutdown = true;
+  }
+  m_task_ready.notify_all();
+  for (auto i = m_workers.begin(); i != m_workers.end(); ++i) {
+    i->join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_tasks.push_back(std::move(task));
+    m_num_pending++;
+  }
+  m_task_ready.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> guard(m_lock);
+  m_all_done.wait(guard, [this] { return m_num_pending == 0; });
+}
+
+void ThreadPool::worker() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> guard(m_lock);
+      m_task_ready.wait(guard, [this] { return m_shutdown || !m_tasks.empty(); });
+      if (m_tasks.empty()) {
+        return; // shutting down
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+
+    task();
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (--m_num_pending == 0) {
+      m_all_done.notify_all();
+    }
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads which run submitted tasks.
+// Tasks must not throw exceptions: catch them inside the task
+// and record the outcome somewhere the submitter can see it.
+
+class ThreadPool {
+private:
+  std::vector<std::thread> m_workers;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_lock;
+  std::condition_variable m_task_ready;  // signaled when a task is submitted
+  std::condition_variable m_all_done;    // signaled when m_num_pending reaches 0
+  unsigned m_num_pending;                // tasks submitted but not finished
+  bool m_shutdown;
+
+  // value semantics prohibited
+  ThreadPool(const ThreadPool &);
+  ThreadPool &operator=(const ThreadPool &);
+
+public:
+  ThreadPool(unsigned num_threads);
+  ~ThreadPool();
+
+  unsigned get_num_threads() const { return unsigned(m_workers.size()); }
+
+  void submit(std::function<void()> task);
+
+  // Wait until all submitted tasks have finished.
+  void wait();
+
+private:
+  void worker();
+};
+
+#endif // THREAD_POOL_H
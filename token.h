@@ -1,8 +1,10 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include "symtab.h"
+
 // This header file defines the tags used for tokens (i.e., terminal
-// symbols in the grammar.)
+// symbols in the grammar), and the Token type.
 
 enum TokenKind {
   TOK_IDENTIFIER,
@@ -40,4 +42,15 @@ enum TokenKind {
   TOK_COMMA
 };
 
+// A token read by the Lexer.  Tokens are small values that refer
+// to their lexeme by its position in the source text, so reading
+// a token never requires memory allocation.  The Lexer provides
+// member functions to get a token's lexeme and Location.
+struct Token {
+  TokenKind kind;
+  unsigned offset;  // offset of the lexeme in the source text
+  unsigned len;     // length of the lexeme
+  Symbol sym;       // interned identifier (NO_SYMBOL if not an identifier)
+};
+
 #endif // TOKEN_H
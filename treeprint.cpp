@@ -23,6 +23,7 @@
 #include <cstdio>
 #include <cassert>
 #include "node.h"
+#include "flat_ast.h"
 #include "treeprint.h"
 
 namespace {
@@ -40,7 +41,10 @@ struct TreePrintContext {
 
   void pushctx(int nsibs);
   void popctx();
-  void print_node(Node *n);
+
+  // NodeRef is Node * or FlatNode
+  template<typename NodeRef>
+  void print_node(NodeRef n);
 };
 
 void TreePrintContext::pushctx(int nsibs_) {
@@ -51,7 +55,8 @@ void TreePrintContext::popctx() {
   stack.pop_back();
 }
 
-void TreePrintContext::print_node(Node *n) {
+template<typename NodeRef>
+void TreePrintContext::print_node(NodeRef n) {
   int depth = int(stack.size());
   assert(depth > 0);
   for (int i = 1; i < depth; i++) {
@@ -69,11 +74,18 @@ void TreePrintContext::print_node(Node *n) {
   }
 
   int tag = n->get_tag();
-  std::string str = n->get_str();
+  std::string_view str = n->get_str();
 
   printf("%s", tp_obj->node_tag_to_string(tag).c_str());
   if (!str.empty()) {
-    printf("[%s]", str.c_str());
+    // only the first line of a multi-line string (such as the
+    // source text of an unparsed function body) is printed
+    size_t len = str.find('\n');
+    if (len == std::string_view::npos) {
+      printf("[%.*s]", int(str.size()), str.data());
+    } else {
+      printf("[%.*s...]", int(len), str.data());
+    }
   }
   printf("\n");
   stack[depth-1].first++;
@@ -99,3 +111,9 @@ void TreePrint::print(Node *t) const {
   ctx.pushctx(1);
   ctx.print_node(t);
 }
+
+void TreePrint::print(const FlatAST &ast) const {
+  TreePrintContext ctx(this);
+  ctx.pushctx(1);
+  ctx.print_node(ast.get_root());
+}
@@ -23,6 +23,7 @@
 
 #include <string>
 struct Node;
+class FlatAST;
 
 class TreePrint {
 public:
@@ -30,6 +31,7 @@ public:
   virtual ~TreePrint();
 
   void print(Node *t) const;
+  void print(const FlatAST &ast) const;
 
   virtual std::string node_tag_to_string(int tag) const = 0;
 };
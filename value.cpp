@@ -4,15 +4,10 @@
 #include "function.h"
 #include "value.h"
 
-Value::Value(int ival)
-  : m_kind(VALUE_INT) {
-  m_atomic.ival = ival;
-}
-
 Value::Value(Function *fn)
   : m_kind(VALUE_FUNCTION)
   , m_rep(fn) {
-  m_rep = fn;
+  m_rep->add_ref();
 }
 
 Value::Value(IntrinsicFn intrinsic_fn)
@@ -20,39 +15,28 @@ Value::Value(IntrinsicFn intrinsic_fn)
   m_atomic.intrinsic_fn = intrinsic_fn;
 }
 
-Value::Value(const Value &other)
-    : m_kind(other.m_kind) {
-    if (other.is_dynamic()) {
-        m_rep = other.m_rep;
-        m_rep->add_ref();
-    } else {
-        m_atomic = other.m_atomic;
-    }
+void Value::copy_rep(const Value &other) {
+    m_rep = other.m_rep;
+    m_rep->add_ref();
 }
 
-Value::~Value() {
-    if (is_dynamic()) {
-        m_rep->remove_ref();
-        if (m_rep->get_num_refs() == 0) {
-            delete m_rep;
-        }
+void Value::release_rep() {
+    m_rep->remove_ref();
+    if (m_rep->get_num_refs() == 0) {
+        delete m_rep;
     }
 }
 
-Value &Value::operator=(const Value &rhs) {
+Value &Value::assign(const Value &rhs) {
     if (this != &rhs) {
         if (is_dynamic()) {
-            m_rep->remove_ref();
-            if (m_rep->get_num_refs() == 0) {
-                delete m_rep;
-            }
+            release_rep();
         }
         m_kind = rhs.m_kind;
         if (rhs.is_dynamic()) {
-            m_rep = rhs.m_rep;
-            m_rep->add_ref();
+            copy_rep(rhs);
         } else {
-            m_atomic = rhs.m_atomic;
+            copy_atomic(rhs);
         }
     }
     return *this;
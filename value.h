@@ -45,13 +45,33 @@ private:
   };
 
 public:
-  Value(int ival = 0);
+  // Values are created, copied and destroyed constantly (by every
+  // instruction the virtual machines execute), so atomic values are
+  // handled inline, and only dynamic values need a function call.
+  Value(int ival = 0) : m_kind(VALUE_INT) { m_atomic.ival = ival; }
   Value(Function *fn);
   Value(IntrinsicFn intrinsic_fn);
-  Value(const Value &other);
-  ~Value();
+  Value(const Value &other) : m_kind(other.m_kind) {
+    if (other.is_dynamic()) {
+      copy_rep(other);
+    } else {
+      copy_atomic(other);
+    }
+  }
+  ~Value() {
+    if (is_dynamic()) {
+      release_rep();
+    }
+  }
 
-  Value &operator=(const Value &rhs);
+  Value &operator=(const Value &rhs) {
+    if (is_atomic() && rhs.is_atomic()) {
+      m_kind = rhs.m_kind;
+      copy_atomic(rhs);
+      return *this;
+    }
+    return assign(rhs);
+  }
 
   ValueKind get_kind() const { return m_kind; }
 
@@ -84,7 +104,20 @@ public:
   bool is_atomic() const  { return !is_dynamic(); }
 
 private:
-  // TODO: add additional member functions, if necessary
+  // An int is copied as an int, so that copying a Value which was just
+  // made from an int doesn't read more memory than was written.
+  void copy_atomic(const Value &other) {
+    if (other.m_kind == VALUE_INT) {
+      m_atomic.ival = other.m_atomic.ival;
+    } else {
+      m_atomic = other.m_atomic;
+    }
+  }
+
+  // the parts of copying and assignment which deal with dynamic values
+  void copy_rep(const Value &other);
+  void release_rep();
+  Value &assign(const Value &rhs);
 };
 
 #endif // VALUE_H
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include "ast.h"
+#include "node.h"
+#include "exceptions.h"
+#include "environment.h"
+#include "function.h"
+#include "bytecode.h"
+#include "interp.h"
+#include "stats.h"
+#include "binary_op.h"
+#include "dispatch.h"
+#include "vm.h"
+
+namespace {
+
+// Initial size of the stack (in Values), which is enough for
+// most programs
+const size_t INITIAL_STACK_SIZE = 4096;
+
+}
+
+VM::VM(Interpreter *interp, BytecodeCompiler *compiler, Environment *globals)
+  : m_interp(interp)
+  , m_compiler(compiler)
+  , m_globals(globals)
+#ifdef THREADED_DISPATCH
+  , m_handlers(nullptr)
+#endif
+{
+}
+
+VM::~VM() {
+}
+
+// Make sure the stack has room for the given number of Values
+// (which may move it)
+void VM::reserve(size_t size) {
+  if (size > m_stack.size()) {
+    m_stack.resize(std::max(size, std::max(2 * m_stack.size(), INITIAL_STACK_SIZE)));
+  }
+}
+
+// Thread code when it is first executed
+void VM::thread(const Bytecode *code) {
+#ifdef THREADED_DISPATCH
+  if (!code->is_threaded()) {
+    code->thread(m_handlers);
+  }
+#endif
+}
+
+Value VM::execute(const Bytecode *program) {
+#ifdef THREADED_DISPATCH
+  static const void *const handlers[] = {
+    HANDLER_ADDRESS(OP_PUSH_INT), HANDLER_ADDRESS(OP_POP), HANDLER_ADDRESS(OP_DUP),
+    HANDLER_ADDRESS(OP_LOAD_LOCAL), HANDLER_ADDRESS(OP_STORE_LOCAL),
+    HANDLER_ADDRESS(OP_DEFINE_LOCAL), HANDLER_ADDRESS(OP_LOAD_GLOBAL),
+    HANDLER_ADDRESS(OP_LOAD_GLOBAL_FN), HANDLER_ADDRESS(OP_STORE_GLOBAL),
+    HANDLER_ADDRESS(OP_DEFINE_GLOBAL), HANDLER_ADDRESS(OP_DEFINE_FUNCTION),
+    HANDLER_ADDRESS(OP_ADD), HANDLER_ADDRESS(OP_SUB), HANDLER_ADDRESS(OP_MULTIPLY),
+    HANDLER_ADDRESS(OP_DIVIDE), HANDLER_ADDRESS(OP_LESS), HANDLER_ADDRESS(OP_LESS_EQUAL),
+    HANDLER_ADDRESS(OP_GREATER), HANDLER_ADDRESS(OP_GREATER_EQUAL),
+    HANDLER_ADDRESS(OP_EQUAL), HANDLER_ADDRESS(OP_NOT_EQUAL), HANDLER_ADDRESS(OP_AND),
+    HANDLER_ADDRESS(OP_OR), HANDLER_ADDRESS(OP_TO_BOOL), HANDLER_ADDRESS(OP_JUMP),
+    HANDLER_ADDRESS(OP_JUMP_IF_FALSE), HANDLER_ADDRESS(OP_CALL), HANDLER_ADDRESS(OP_RETURN),
+  };
+  static_assert(sizeof(handlers) / sizeof(handlers[0]) == OP_NUM_OPCODES, "a handler is missing");
+  m_handlers = handlers;
+#endif
+
+  const Bytecode *code = program;
+  reserve(code->get_num_locals() + code->get_max_stack());
+  thread(code);
+  const Instruction *ip = code->get_code();
+  const Instruction *ins;
+  Value *bp = m_stack.data();
+  Value *sp = bp + code->get_num_locals();
+  unsigned long num_executed = 0;
+
+// the index of the instruction being executed
+#define PC unsigned(ip - 1 - code->get_code())
+
+// a binary operator (see BinaryOp) on the top two values of the stack
+#define BINARY_OP(tag) \
+  sp[-2] = apply_binary_op<BinaryOp<tag>>(sp[-2], sp[-1], code->get_loc(PC)); \
+  --sp; \
+  DISPATCH()
+
+#ifdef THREADED_DISPATCH
+  DISPATCH();
+#else
+  while (true) {
+    ins = ip++;
+    num_executed++;
+    switch (ins->op) {
+#endif
+      HANDLER(OP_PUSH_INT)
+        *sp++ = Value(ins->a);
+        DISPATCH();
+      HANDLER(OP_POP)
+        --sp;
+        DISPATCH();
+      HANDLER(OP_DUP)
+        *sp = sp[-1];
+        ++sp;
+        DISPATCH();
+      HANDLER(OP_LOAD_LOCAL)
+        *sp++ = bp[ins->a];
+        DISPATCH();
+      HANDLER(OP_STORE_LOCAL)
+        bp[ins->a] = *--sp;
+        DISPATCH();
+      HANDLER(OP_DEFINE_LOCAL)
+        bp[ins->a] = Value(0);
+        DISPATCH();
+      HANDLER(OP_LOAD_GLOBAL)
+      HANDLER(OP_LOAD_GLOBAL_FN) {
+        Value *var = m_globals->get_slot(unsigned(ins->a), unsigned(ins->b));
+        if (var == nullptr) {
+          if (ins->op == OP_LOAD_GLOBAL_FN) {
+            RuntimeError::raise("Undefined variable: '%s'", SymbolTable::get_name(code->get_name(PC)).c_str());
+          }
+          RuntimeError::raise("Undefined variable '%s' during execution.", SymbolTable::get_name(code->get_name(PC)).c_str());
+        }
+        *sp++ = *var;
+        DISPATCH();
+      }
+      HANDLER(OP_STORE_GLOBAL) {
+        Value *var = m_globals->get_slot(unsigned(ins->a), unsigned(ins->b));
+        if (var == nullptr) {
+          SemanticError::raise(code->get_loc(PC), "Assignment to undefined variable '%s'.", SymbolTable::get_name(code->get_name(PC)).c_str());
+        }
+        *var = *--sp;
+        DISPATCH();
+      }
+      HANDLER(OP_DEFINE_GLOBAL)
+        if (!m_globals->define_variable(Symbol(ins->a), Value(0))) {
+          EvaluationError::raise(code->get_loc(PC), "Variable '%s' already defined in this scope.", SymbolTable::get_name(Symbol(ins->a)).c_str());
+        }
+        DISPATCH();
+      HANDLER(OP_DEFINE_FUNCTION)
+        if (!m_globals->define_variable(code->get_name(PC), m_compiler->get_function(unsigned(ins->a)))) {
+          EvaluationError::raise(code->get_loc(PC), "Variable '%s' already defined in this scope.", SymbolTable::get_name(code->get_name(PC)).c_str());
+        }
+        DISPATCH();
+      HANDLER(OP_ADD)
+        BINARY_OP(AST_ADD);
+      HANDLER(OP_SUB)
+        BINARY_OP(AST_SUB);
+      HANDLER(OP_MULTIPLY)
+        BINARY_OP(AST_MULTIPLY);
+      HANDLER(OP_DIVIDE)
+        BINARY_OP(AST_DIVIDE);
+      HANDLER(OP_LESS)
+        BINARY_OP(AST_LESS);
+      HANDLER(OP_LESS_EQUAL)
+        BINARY_OP(AST_LESS_EQUAL);
+      HANDLER(OP_GREATER)
+        BINARY_OP(AST_GREATER);
+      HANDLER(OP_GREATER_EQUAL)
+        BINARY_OP(AST_GREATER_EQUAL);
+      HANDLER(OP_EQUAL)
+        BINARY_OP(AST_EQUAL);
+      HANDLER(OP_NOT_EQUAL)
+        BINARY_OP(AST_NOT_EQUAL);
+      HANDLER(OP_AND)
+      HANDLER(OP_OR)
+      HANDLER(OP_TO_BOOL) {
+        Value &val = *--sp;
+        if (!val.is_int()) {
+          EvaluationError::raise(code->get_loc(PC), "Operand must be an integer.");
+        }
+        bool is_true = val.get_ival() != 0;
+        if (ins->op == OP_TO_BOOL) {
+          *sp++ = Value(is_true ? 1 : 0);
+        } else if (is_true == (ins->op == OP_OR)) {
+          // short-circuit
+          *sp++ = Value(is_true ? 1 : 0);
+          ip = code->get_code() + ins->a;
+        }
+        DISPATCH();
+      }
+      HANDLER(OP_JUMP)
+        ip = code->get_code() + ins->a;
+        DISPATCH();
+      HANDLER(OP_JUMP_IF_FALSE) {
+        Value &cond = *--sp;
+        if (!cond.is_int()) {
+          EvaluationError::raise(code->get_loc(PC), "Condition must evaluate to an integer");
+        }
+        if (cond.get_ival() == 0) {
+          ip = code->get_code() + ins->a;
+        }
+        DISPATCH();
+      }
+      HANDLER(OP_CALL) {
+        unsigned num_args = unsigned(ins->a);
+        Value *callee = sp - num_args - 1;
+        if (callee->is_intrinsic_fn()) {
+          Value result = callee->get_intrinsic_fn()(callee + 1, num_args, code->get_loc(PC), m_interp);
+          sp = callee;
+          *sp++ = result;
+          DISPATCH();
+        }
+
+        // the arguments become the first local variables of the call
+        const Bytecode *fn_code = m_compiler->compile_function(m_interp->check_call(*callee, num_args, code->get_loc(PC), code->get_name(PC)));
+        Interpreter::check_call_depth(m_frames.size());
+        thread(fn_code);
+        m_frames.push_back({ code, unsigned(ip - code->get_code()), size_t(bp - m_stack.data()) });
+        size_t base = size_t(callee + 1 - m_stack.data());
+        reserve(base + fn_code->get_num_locals() + fn_code->get_max_stack());
+        code = fn_code;
+        ip = code->get_code();
+        bp = m_stack.data() + base;
+        sp = bp + code->get_num_locals();
+        DISPATCH();
+      }
+      HANDLER(OP_RETURN) {
+        Value result = sp[-1];
+        if (m_frames.empty()) {
+          Stats::instructions_executed += num_executed;
+          return result;
+        }
+        // the result replaces the function that was called
+        sp = bp - 1;
+        *sp++ = result;
+        const Frame &caller = m_frames.back();
+        code = caller.code;
+        ip = code->get_code() + caller.pc;
+        bp = m_stack.data() + caller.base;
+        m_frames.pop_back();
+        DISPATCH();
+      }
+#ifndef THREADED_DISPATCH
+      default:
+        RuntimeError::raise("Unknown opcode %d.", int(ins->op));
+    }
+  }
+#endif
+
+#undef BINARY_OP
+#undef PC
+}
@@ -0,0 +1,54 @@
+#ifndef VM_H
+#define VM_H
+
+#include <vector>
+#include "value.h"
+#include "dispatch.h"
+class Bytecode;
+class BytecodeCompiler;
+class Environment;
+class Interpreter;
+
+// A virtual machine which executes Bytecode.  Each call has a frame
+// on one stack of Values: the function being called, followed by
+// the call's local variables (starting with its arguments, which
+// the caller pushed), followed by its operand stack.  Calls don't
+// use the native stack, but the depth of recursion is limited to
+// Interpreter::MAX_CALL_DEPTH, as in the other engines.
+class VM {
+private:
+  // a call which is waiting for a call it made to return
+  struct Frame {
+    const Bytecode *code;
+    unsigned pc;      // where to continue
+    size_t base;      // stack index of the call's local variable 0
+  };
+
+  Interpreter *m_interp;
+  BytecodeCompiler *m_compiler;
+  Environment *m_globals;
+  std::vector<Value> m_stack;
+  std::vector<Frame> m_frames;
+#ifdef THREADED_DISPATCH
+  const void *const *m_handlers;  // the handler for each opcode
+#endif
+
+  // value semantics prohibited
+  VM(const VM &);
+  VM &operator=(const VM &);
+
+public:
+  // Lazily-parsed function bodies are analyzed by the interpreter, and
+  // functions are compiled by the compiler, when they're first called.
+  VM(Interpreter *interp, BytecodeCompiler *compiler, Environment *globals);
+  ~VM();
+
+  // Execute the program, returning its result.
+  Value execute(const Bytecode *program);
+
+private:
+  void reserve(size_t size);
+  void thread(const Bytecode *code);
+};
+
+#endif // VM_H